@@ -161,23 +161,99 @@ MppSplitBaseTreble(const int *score, uint8_t num, int *base, uint8_t *nbase,
 	*ntreble = nt;
 }
 
+MppFileMap :: MppFileMap(const QString &fname)
+{
+	qint64 len;
+
+	mapped = 0;
+	data = 0;
+	size = 0;
+	valid = false;
+
+	file.setFileName(fname);
+
+	if (!file.open(QIODevice::ReadOnly))
+		return;
+
+	len = file.size();
+	if (len < 0 || len > 0xFFFFFFFFLL) {
+		file.close();
+		return;
+	}
+	if (len == 0) {
+		file.close();
+		valid = true;
+		return;
+	}
+
+	mapped = file.map(0, len);
+	if (mapped != 0) {
+		data = mapped;
+		size = len;
+		valid = true;
+		return;
+	}
+
+	/* fallback for files which cannot be mapped */
+	if (len > MPP_FILEMAP_COPY_MAX) {
+		file.close();
+		return;
+	}
+
+	copy = file.read(len);
+	file.close();
+
+	if (copy.size() != len) {
+		copy.clear();
+		return;
+	}
+	data = (const uint8_t *)copy.constData();
+	size = len;
+	valid = true;
+}
+
+MppFileMap :: ~MppFileMap()
+{
+	close();
+}
+
+void
+MppFileMap :: close(void)
+{
+	if (mapped != 0) {
+		file.unmap(mapped);
+		mapped = 0;
+	}
+	file.close();
+	copy.clear();
+	data = 0;
+	size = 0;
+}
+
+/* the returned array must not outlive the file view */
+QByteArray
+MppFileMap :: bytes(void) const
+{
+	return (QByteArray::fromRawData((const char *)data, size));
+}
+
 Q_DECL_EXPORT QString
 MppReadFile(const QString &fname)
 {
-	QFile file(fname);
+	MppFileMap map(fname);
 	QString retval;
 	QMessageBox box;
 
-	if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+	if (map.valid == false)
 		goto error;
 
-	retval = QString::fromUtf8(file.readAll());
-	if (file.error()) {
-		file.close();
-		goto error;
-	}
+	/* decode directly from the file view */
+	retval = QString::fromUtf8((const char *)map.data, map.size);
+
+	/* same line endings as reading in text mode */
+	if (retval.contains(QChar('\r')))
+		retval.replace(QString("\r\n"), QString("\n"));
 
-	file.close();
 	return (retval);
 
 error:
@@ -389,6 +465,41 @@ MppTrans(int *ptr, size_t num, int ntrans)
 	}
 }
 
+/*
+ * Sequence lock helpers. There must only be one writer at a time,
+ * while readers never block the writer.
+ */
+Q_DECL_EXPORT void
+MppSeqWrite(uint32_t *pseq, void *dst, const void *src, size_t size)
+{
+	uint32_t seq = __atomic_load_n(pseq, __ATOMIC_RELAXED);
+
+	__atomic_store_n(pseq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	memcpy(dst, src, size);
+
+	__atomic_store_n(pseq, seq + 2, __ATOMIC_RELEASE);
+}
+
+Q_DECL_EXPORT void
+MppSeqRead(uint32_t *pseq, void *dst, const void *src, size_t size)
+{
+	uint32_t seq;
+
+	while (1) {
+		seq = __atomic_load_n(pseq, __ATOMIC_ACQUIRE);
+		if (seq & 1)
+			continue;
+
+		memcpy(dst, src, size);
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(pseq, __ATOMIC_RELAXED) == seq)
+			break;
+	}
+}
+
 #ifdef HAVE_SCREENSHOT
 Q_DECL_EXPORT void
 MppScreenShot(QWidget *widget, QApplication &app)
@@ -38,6 +38,7 @@
 #include <QTextEdit>
 #include <QScrollBar>
 #include <QPlainTextEdit>
+#include <QProgressDialog>
 #include <QTabBar>
 #include <QStackedWidget>
 #include <QLabel>
@@ -103,17 +104,23 @@
 #define	MPP_MAX_BUTTON_MAP	16
 #define	MPP_MAX_VIEWS	2
 #define	MPP_MAX_TRACKS		(MPP_TRACKS_PER_VIEW * MPP_MAX_VIEWS)
-#define	MPP_MAX_LINES	8192
 #define	MPP_MAX_SCORES	32
 #define	MPP_MAX_LABELS	32
-#define	MPP_MAX_QUEUE	32
+#ifndef MPP_MAX_QUEUE
+#define	MPP_MAX_QUEUE	1024	/* power of two */
+#endif
 #define	MPP_MAX_DEVS	8
 #define	MPP_MAX_BPM	32
 #define	MPP_MAX_LBUTTON	16
 #define	MPP_MIN_POS	4	/* ticks */
 #define	MPP_WHEEL_STEP	(8 * 15)
-#define	MPP_PRESSED_MAX	128
+#ifndef MPP_PRESSED_MAX
+#define	MPP_PRESSED_MAX	128	/* pressed keys per view */
+#endif
 #define	MPP_MAX_DURATION 255	/* inclusive */
+#ifndef MPP_FILEMAP_COPY_MAX
+#define	MPP_FILEMAP_COPY_MAX (64 * 1024 * 1024)	/* bytes */
+#endif
 #define	MPP_MAGIC_DEVNO	(UMIDI20_N_DEVICES - MPP_MAX_TRACKS)
 #define	MPP_DEFAULT_URL "http://home.selasky.org/midipp/database.tar.gz"
 #define	MPP_DEFAULT_CMD_KEY C3
@@ -124,7 +131,9 @@
 #define	MPP_VOLUME_UNIT		127
 #define	MPP_VOLUME_MAX		511	/* inclusivly */
 #define	MPP_CUSTOM_MAX		10
-#define	MPP_LOOP_MAX		16
+#ifndef MPP_LOOP_MAX
+#define	MPP_LOOP_MAX		16	/* at most 64 */
+#endif
 #define	MPP_MAX_TABS		32
 #define	MPP_MAX_WIDGETS		32
 #define	MPP_PIANO_TAB_LABELS	10	/* hard coded */
@@ -265,14 +274,23 @@ class MppGroupBox;
 class MppHead;
 class MppImportTab;
 class MppInstrumentTab;
+class MppLatency;
+class MppLock;
 class MppLoopTab;
 class MppMainWindow;
 class MppMidi;
+class MppMidiConv;
+class MppMidiJournal;
+class MppMidiLoad;
+class MppMidiSave;
 class MppMetronome;
 class MppMode;
 class MppPianoTab;
+class MppPressed;
+class MppRecord;
 class MppReplace;
 class MppReplayTab;
+class MppRing;
 class MppScoreHighLighter;
 class MppScoreMain;
 class MppScoreView;
@@ -284,6 +302,7 @@ class MppShowControl;
 class MppShowWidget;
 class MppSpinBox;
 class MppTabBar;
+class MppTempo;
 class MppVolume;
 
 struct MppChord;
@@ -355,6 +374,27 @@ public:
     static void sleep(unsigned long secs) { QThread::sleep(secs); }
 };
 
+/*
+ * Read-only view of a file. The file is memory mapped when possible,
+ * so that parsers can consume it without copying. Else a file of up
+ * to MPP_FILEMAP_COPY_MAX bytes is read into memory.
+ */
+class MppFileMap {
+public:
+	MppFileMap(const QString &);
+	~MppFileMap();
+
+	void close(void);
+	QByteArray bytes(void) const;
+
+	QFile file;
+	QByteArray copy;
+	uchar *mapped;
+	const uint8_t *data;
+	uint32_t size;
+	bool valid;
+};
+
 extern Mpp Mpp;
 
 extern const QString MppChanName(int, int = 0);
@@ -377,6 +417,8 @@ typedef int (MppCmp_t)(void *, const void *, const void *);
 extern void MppSort(void *, size_t, size_t, MppCmp_t *, void *);
 extern void MppSort(int *, size_t);
 extern void MppTrans(int *ptr, size_t num, int ntrans);
+extern void MppSeqWrite(uint32_t *, void *, const void *, size_t);
+extern void MppSeqRead(uint32_t *, void *, const void *, size_t);
 
 #ifdef HAVE_SCREENSHOT
 extern void MppScreenShot(QWidget *, QApplication &);
@@ -80,6 +80,22 @@ DEFINES += HAVE_NO_SHOW
 DEFINES += HAVE_SCREENSHOT
 }
 
+!isEmpty(HAVE_LOCK_DEBUG) {
+DEFINES += HAVE_LOCK_DEBUG
+}
+
+!isEmpty(MPP_MAX_QUEUE) {
+DEFINES += MPP_MAX_QUEUE=$${MPP_MAX_QUEUE}
+}
+
+!isEmpty(MPP_PRESSED_MAX) {
+DEFINES += MPP_PRESSED_MAX=$${MPP_PRESSED_MAX}
+}
+
+!isEmpty(MPP_LOOP_MAX) {
+DEFINES += MPP_LOOP_MAX=$${MPP_LOOP_MAX}
+}
+
 HEADERS		+= midipp.h
 HEADERS		+= midipp_bpm.h
 HEADERS		+= midipp_button.h
@@ -98,16 +114,25 @@ HEADERS		+= midipp_groupbox.h
 HEADERS		+= midipp_gridlayout.h
 HEADERS		+= midipp_import.h
 HEADERS		+= midipp_instrument.h
+HEADERS		+= midipp_latency.h
+HEADERS		+= midipp_lock.h
 HEADERS		+= midipp_looptab.h
 HEADERS		+= midipp_mainwindow.h
 HEADERS		+= midipp_metronome.h
 HEADERS		+= midipp_midi.h
+HEADERS		+= midipp_midiconv.h
+HEADERS		+= midipp_midijournal.h
+HEADERS		+= midipp_midiload.h
+HEADERS		+= midipp_midisave.h
 HEADERS		+= midipp_mode.h
 HEADERS		+= midipp_musicxml.h
 HEADERS		+= midipp_mutemap.h
 HEADERS		+= midipp_pianotab.h
+HEADERS		+= midipp_pressed.h
+HEADERS		+= midipp_record.h
 HEADERS		+= midipp_replace.h
 HEADERS		+= midipp_replay.h
+HEADERS		+= midipp_ring.h
 HEADERS		+= midipp_scores.h
 HEADERS		+= midipp_settings.h
 HEADERS		+= midipp_sheet.h
@@ -116,7 +141,9 @@ HEADERS		+= midipp_show.h
 }
 HEADERS		+= midipp_spinbox.h
 HEADERS		+= midipp_shortcut.h
+HEADERS		+= midipp_shortcutmap.h
 HEADERS		+= midipp_tabbar.h
+HEADERS		+= midipp_tempo.h
 HEADERS		+= midipp_volume.h
 SOURCES		+= midipp.cpp
 SOURCES		+= midipp_bpm.cpp
@@ -136,16 +163,25 @@ SOURCES		+= midipp_groupbox.cpp
 SOURCES		+= midipp_gridlayout.cpp
 SOURCES		+= midipp_import.cpp
 SOURCES		+= midipp_instrument.cpp
+SOURCES		+= midipp_latency.cpp
+SOURCES		+= midipp_lock.cpp
 SOURCES		+= midipp_looptab.cpp
 SOURCES		+= midipp_mainwindow.cpp
 SOURCES		+= midipp_metronome.cpp
 SOURCES		+= midipp_midi.cpp
+SOURCES		+= midipp_midiconv.cpp
+SOURCES		+= midipp_midijournal.cpp
+SOURCES		+= midipp_midiload.cpp
+SOURCES		+= midipp_midisave.cpp
 SOURCES		+= midipp_mode.cpp
 SOURCES		+= midipp_musicxml.cpp
 SOURCES		+= midipp_mutemap.cpp
 SOURCES		+= midipp_pianotab.cpp
+SOURCES		+= midipp_pressed.cpp
+SOURCES		+= midipp_record.cpp
 SOURCES		+= midipp_replace.cpp
 SOURCES		+= midipp_replay.cpp
+SOURCES		+= midipp_ring.cpp
 SOURCES		+= midipp_scores.cpp
 SOURCES		+= midipp_settings.cpp
 SOURCES		+= midipp_sheet.cpp
@@ -153,8 +189,10 @@ isEmpty(HAVE_NO_SHOW) {
 SOURCES		+= midipp_show.cpp
 }
 SOURCES		+= midipp_tabbar.cpp
+SOURCES		+= midipp_tempo.cpp
 SOURCES		+= midipp_spinbox.cpp
 SOURCES		+= midipp_shortcut.cpp
+SOURCES		+= midipp_shortcutmap.cpp
 SOURCES		+= midipp_volume.cpp
 
 RESOURCES	+= midipp.qrc
@@ -37,20 +37,31 @@ MppTimerCallback(void *arg)
 	MppBpm *mb = (MppBpm *)arg;
 	MppMainWindow *mw = mb->mw;
 	MppScoreMain *sm;
+	uint32_t views = 0;
 	uint8_t temp;
 	int n;
 
+	/* lock the output views before the main lock */
+	for (n = 0; n != MPP_MAX_VIEWS; n++) {
+		if (__atomic_load_n(&mb->view_out[n], __ATOMIC_RELAXED) == 0)
+			continue;
+		views |= (1U << n);
+		mw->scores_main[n]->atomicLock();
+	}
+
 	mw->atomic_lock();
 
 	mb->last_timeout = umidi20_get_curr_position();
 
+	mb->tempo.beat(mb->last_timeout);
 	mb->handle_update();
 
 	if (mb->enabled != 0 && mw->midiTriggered != 0) {
 		if (mb->duty_ticks != 0 && mb->amp != 0) {
 
 			for (n = 0; n != MPP_MAX_VIEWS; n++) {
-				if (mb->view_out[n] == 0)
+				if (mb->view_out[n] == 0 ||
+				    (views & (1U << n)) == 0)
 					continue;
 
 				/* avoid feedback */
@@ -69,6 +80,11 @@ MppTimerCallback(void *arg)
 			mw->send_byte_event_locked(0xF8);
 	}
 	mw->atomic_unlock();
+
+	for (n = MPP_MAX_VIEWS; n-- != 0; ) {
+		if (views & (1U << n))
+			mw->scores_main[n]->atomicUnlock();
+	}
 }
 
 MppBpm :: MppBpm(MppMainWindow *parent)
@@ -370,7 +386,13 @@ MppBpm :: handle_update(int restart)
 
 	duty_ticks = ((time_ms * duty) + ((2 * 100) - 1)) / (2 * 100);
 
-	umidi20_update_timer(&MppTimerCallback, this, time_ms, (restart != 0));
+	/* the exact period is a fraction of milliseconds */
+	tempo.setPeriod(bpm_get(), bpm_other);
+	if (restart != 0)
+		tempo.resync();
+
+	umidi20_update_timer(&MppTimerCallback, this,
+	    (restart != 0) ? time_ms : tempo.delay(), (restart != 0));
 }
 
 void
@@ -423,7 +445,7 @@ void
 MppBpm :: handle_jump_event_locked(int view_index)
 {
 	if (view_index < 0 || view_index >= MPP_MAX_VIEWS ||
-	    view_sync[view_index] == 0)
+	    view_sync[view_index] == 0 || mw->renderActive != 0)
 		return;
 
 	history_out = 0;
@@ -451,7 +473,7 @@ MppBpm :: handle_beat_event_locked(int view_index)
 	uint32_t pos;
 
 	if (view_index < 0 || view_index >= MPP_MAX_VIEWS ||
-	    view_sync[view_index] == 0)
+	    view_sync[view_index] == 0 || mw->renderActive != 0)
 		return;
 
 	pos = umidi20_get_curr_position();
@@ -487,6 +509,8 @@ MppBpm :: handle_beat_event_locked(int view_index)
 		limit_ms = 0;
 
 	/* check if beat is speeding up */
-	if ((uint32_t)(pos - last_timeout) > limit_ms)
+	if ((uint32_t)(pos - last_timeout) > limit_ms) {
+		tempo.resync();
 		umidi20_update_timer(&MppTimerCallback, this, time_ms, 1);
+	}
 }
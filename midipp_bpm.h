@@ -27,6 +27,7 @@
 #define	_MIDIPP_BPM_H_
 
 #include "midipp.h"
+#include "midipp_tempo.h"
 
 class MppBpm : public QDialog
 {
@@ -73,6 +74,8 @@ public:
 
 	uint32_t last_timeout;
 
+	MppTempo tempo;
+
 	uint32_t enabled;
 	uint32_t bpm_cur;
 	uint32_t bpm_other;
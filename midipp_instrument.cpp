@@ -229,6 +229,7 @@ MppInstrumentTab :: handle_instr_changed(int dummy)
 				temp[2] = mw->instr[x].muted;
 			} else {
 				mw->instr[x].muted = temp[2];
+				mw->tx_route_update_locked();
 				mw->instr[x].updated |= 1;
 			}
 			update_curr = 1;
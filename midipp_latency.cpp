@@ -0,0 +1,358 @@
+/*-
+ * Copyright (c) 2019 Hans Petter Selasky. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <time.h>
+
+#include "midipp_latency.h"
+#include "midipp_mainwindow.h"
+#include "midipp_groupbox.h"
+#include "midipp_ring.h"
+#include "midipp_record.h"
+
+static const char *MppLatencyName[MPP_LATENCY_MAX] = {
+	"Lock wait",
+	"Lock hold",
+	"RX handler",
+	"RX to TX",
+};
+
+static __thread int MppLatencySlot = -1;
+
+static unsigned
+MppLatencyBucket(uint32_t value)
+{
+	unsigned shift;
+
+	if (value < MPP_LATENCY_SUB)
+		return (value);
+
+	/* logarithmic buckets with linear sub-buckets */
+	shift = 31 - __builtin_clz(value);
+
+	return ((shift - 2) * MPP_LATENCY_SUB +
+	    ((value >> (shift - 3)) & (MPP_LATENCY_SUB - 1)));
+}
+
+static uint32_t
+MppLatencyValue(unsigned index)
+{
+	unsigned shift;
+
+	if (index < MPP_LATENCY_SUB)
+		return (index);
+
+	shift = (index / MPP_LATENCY_SUB) + 2;
+
+	return ((MPP_LATENCY_SUB + (index % MPP_LATENCY_SUB)) << (shift - 3));
+}
+
+MppLatency :: MppLatency(MppMainWindow *_mw)
+{
+	mw = _mw;
+
+	memset(hist, 0, sizeof(hist));
+	alloc_events = 0;
+	alloc_bytes = 0;
+	alloc_stamp = now();
+	rx_stamp = 0;
+	lock_stamp = 0;
+	lock_depth = 0;
+	threads = 0;
+
+	txt_config = new QPlainTextEdit();
+	txt_config->setReadOnly(true);
+	txt_config->setLineWrapMode(QPlainTextEdit::NoWrap);
+
+	but_refresh = new QPushButton(tr("Refresh"));
+	but_reset = new QPushButton(tr("Reset"));
+	but_save = new QPushButton(tr("Save to file"));
+
+	connect(but_refresh, SIGNAL(released()), this, SLOT(handle_refresh()));
+	connect(but_reset, SIGNAL(released()), this, SLOT(handle_reset()));
+	connect(but_save, SIGNAL(released()), this, SLOT(handle_save()));
+
+	gb_config = new MppGroupBox(tr("MIDI latency statistics"));
+	gb_config->addWidget(txt_config, 0, 0, 1, 4);
+	gb_config->addWidget(but_refresh, 1, 0, 1, 1);
+	gb_config->addWidget(but_reset, 1, 1, 1, 1);
+	gb_config->addWidget(but_save, 1, 2, 1, 1);
+	gb_config->setColumnStretch(3, 1);
+}
+
+MppLatency :: ~MppLatency()
+{
+}
+
+/* returns monotonic time in microseconds */
+uint64_t
+MppLatency :: now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((uint64_t)ts.tv_sec * 1000000ULL + (ts.tv_nsec / 1000));
+}
+
+/* can be called from any thread, locked or unlocked */
+void
+MppLatency :: record(int which, uint64_t delta)
+{
+	struct MppLatencyHist *ph;
+	uint32_t value;
+	uint32_t old;
+	int slot;
+
+	slot = MppLatencySlot;
+	if (slot < 0) {
+		slot = __atomic_fetch_add(&threads, 1, __ATOMIC_RELAXED);
+		if (slot >= MPP_LATENCY_THREADS)
+			slot = MPP_LATENCY_THREADS - 1;
+		MppLatencySlot = slot;
+	}
+
+	value = (delta > 0xFFFFFFFFULL) ? 0xFFFFFFFFU : delta;
+	ph = &hist[slot][which];
+
+	/* the last slot may be shared, so always use atomics */
+	__atomic_fetch_add(&ph->bucket[MppLatencyBucket(value)], 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&ph->count, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&ph->sum, value, __ATOMIC_RELAXED);
+
+	old = __atomic_load_n(&ph->max, __ATOMIC_RELAXED);
+	while (value > old) {
+		if (__atomic_compare_exchange_n(&ph->max, &old, value, 0,
+		    __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			break;
+	}
+}
+
+/* must be called locked */
+void
+MppLatency :: lockAcquired(uint64_t start)
+{
+	uint64_t curr;
+
+	if (lock_depth++ != 0)
+		return;
+
+	curr = now();
+	record(MPP_LATENCY_LOCK_WAIT, curr - start);
+	lock_stamp = curr;
+}
+
+/* must be called locked */
+void
+MppLatency :: lockReleased(void)
+{
+	if (lock_depth == 0 || --lock_depth != 0)
+		return;
+
+	record(MPP_LATENCY_LOCK_HOLD, now() - lock_stamp);
+}
+
+void
+MppLatency :: rxEvent(void)
+{
+	__atomic_store_n(&rx_stamp, now(), __ATOMIC_RELAXED);
+}
+
+void
+MppLatency :: txEvent(void)
+{
+	uint64_t stamp;
+
+	/* only the first transmitted event after a received one counts */
+	stamp = __atomic_exchange_n(&rx_stamp, 0, __ATOMIC_RELAXED);
+	if (stamp != 0)
+		record(MPP_LATENCY_RX_TO_TX, now() - stamp);
+}
+
+/* can be called from any thread, locked or unlocked */
+void
+MppLatency :: txAlloc(uint32_t events, uint32_t bytes)
+{
+	__atomic_fetch_add(&alloc_events, events, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&alloc_bytes, bytes, __ATOMIC_RELAXED);
+}
+
+void
+MppLatency :: reset(void)
+{
+	__atomic_store_n(&alloc_events, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&alloc_bytes, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&alloc_stamp, now(), __ATOMIC_RELAXED);
+
+	for (unsigned x = 0; x != MPP_LATENCY_THREADS; x++) {
+		for (unsigned y = 0; y != MPP_LATENCY_MAX; y++) {
+			struct MppLatencyHist *ph = &hist[x][y];
+
+			for (unsigned z = 0; z != MPP_LATENCY_BUCKETS; z++)
+				__atomic_store_n(&ph->bucket[z], 0, __ATOMIC_RELAXED);
+			__atomic_store_n(&ph->max, 0, __ATOMIC_RELAXED);
+			__atomic_store_n(&ph->count, 0, __ATOMIC_RELAXED);
+			__atomic_store_n(&ph->sum, 0, __ATOMIC_RELAXED);
+		}
+	}
+}
+
+QString
+MppLatency :: toString(void)
+{
+	static const uint32_t pct[] = { 500, 900, 990, 999 };
+	struct MppLatencyHist sum;
+	QString out;
+	char buf[128];
+	uint64_t events;
+	uint64_t bytes;
+	uint64_t delta;
+
+	out += QString("# Values are in microseconds\n");
+
+	snprintf(buf, sizeof(buf), "\nScore record drops: %u\n"
+	    "Control event overflows: %u\n"
+	    "Extended key evictions: %u\n"
+	    "Extended key overflows: %u\n"
+	    "MPE channel overflows: %u\n",
+	    __atomic_load_n(&mw->scoreRec->dropped, __ATOMIC_RELAXED),
+	    mw->controlEvents->overflows(),
+	    __atomic_load_n(&mw->extEvictions, __ATOMIC_RELAXED),
+	    __atomic_load_n(&mw->extOverflows, __ATOMIC_RELAXED),
+	    __atomic_load_n(&mw->mpeOverflows, __ATOMIC_RELAXED));
+	out += QString(buf);
+
+	snprintf(buf, sizeof(buf), "\nTX rate limit: delayed=%u "
+	    "merged=%u flushed=%u\n",
+	    __atomic_load_n(&mw->txDelayed, __ATOMIC_RELAXED),
+	    __atomic_load_n(&mw->txMerged, __ATOMIC_RELAXED),
+	    __atomic_load_n(&mw->txFlushed, __ATOMIC_RELAXED));
+	out += QString(buf);
+
+	events = __atomic_load_n(&alloc_events, __ATOMIC_RELAXED);
+	bytes = __atomic_load_n(&alloc_bytes, __ATOMIC_RELAXED);
+	delta = now() - __atomic_load_n(&alloc_stamp, __ATOMIC_RELAXED);
+	if (delta < 1000000ULL)
+		delta = 1000000ULL;
+
+	snprintf(buf, sizeof(buf), "\nTX fan-out allocations: %llu "
+	    "(%llu/s, %llu bytes/s)\n",
+	    (unsigned long long)events,
+	    (unsigned long long)(events * 1000000ULL / delta),
+	    (unsigned long long)(bytes * 1000000ULL / delta));
+	out += QString(buf);
+
+	for (unsigned y = 0; y != MPP_LATENCY_MAX; y++) {
+		uint64_t limit;
+		uint64_t count;
+		unsigned z;
+
+		/* merge the per-thread histograms */
+		memset(&sum, 0, sizeof(sum));
+
+		for (unsigned x = 0; x != MPP_LATENCY_THREADS; x++) {
+			struct MppLatencyHist *ph = &hist[x][y];
+			uint32_t temp;
+
+			for (z = 0; z != MPP_LATENCY_BUCKETS; z++) {
+				temp = __atomic_load_n(&ph->bucket[z], __ATOMIC_RELAXED);
+				sum.bucket[z] += temp;
+				sum.count += temp;
+			}
+			sum.sum += __atomic_load_n(&ph->sum, __ATOMIC_RELAXED);
+			temp = __atomic_load_n(&ph->max, __ATOMIC_RELAXED);
+			if (temp > sum.max)
+				sum.max = temp;
+		}
+
+		snprintf(buf, sizeof(buf), "\n%s: count=%llu avg=%llu max=%u\n",
+		    MppLatencyName[y], (unsigned long long)sum.count,
+		    (unsigned long long)(sum.count ? (sum.sum / sum.count) : 0),
+		    sum.max);
+		out += QString(buf);
+
+		if (sum.count == 0)
+			continue;
+
+		for (unsigned x = 0; x != (sizeof(pct) / sizeof(pct[0])); x++) {
+			limit = (sum.count * pct[x] + 999) / 1000;
+			count = 0;
+			for (z = 0; z != MPP_LATENCY_BUCKETS; z++) {
+				count += sum.bucket[z];
+				if (count >= limit)
+					break;
+			}
+			snprintf(buf, sizeof(buf), "  p%u.%u <= %u\n",
+			    pct[x] / 10, pct[x] % 10,
+			    (z + 1 < MPP_LATENCY_BUCKETS) ?
+			    MppLatencyValue(z + 1) - 1 : sum.max);
+			out += QString(buf);
+		}
+
+		for (z = 0; z != MPP_LATENCY_BUCKETS; z++) {
+			if (sum.bucket[z] == 0)
+				continue;
+			snprintf(buf, sizeof(buf), "  [%u..%u] %u\n",
+			    MppLatencyValue(z),
+			    (z + 1 < MPP_LATENCY_BUCKETS) ?
+			    MppLatencyValue(z + 1) - 1 : 0xFFFFFFFFU,
+			    sum.bucket[z]);
+			out += QString(buf);
+		}
+	}
+	return (out);
+}
+
+void
+MppLatency :: handle_refresh()
+{
+	txt_config->setPlainText(toString());
+}
+
+void
+MppLatency :: handle_reset()
+{
+	reset();
+	handle_refresh();
+}
+
+void
+MppLatency :: handle_save()
+{
+	QFileDialog *diag =
+	  new QFileDialog(mw, tr("Save latency statistics"),
+		Mpp.HomeDirTxt,
+		QString("Text File (*.txt *.TXT)"));
+
+	diag->setAcceptMode(QFileDialog::AcceptSave);
+	diag->setFileMode(QFileDialog::AnyFile);
+	diag->setDefaultSuffix(QString("txt"));
+
+	if (diag->exec()) {
+		Mpp.HomeDirTxt = diag->directory().path();
+		MppWriteFile(diag->selectedFiles()[0], toString());
+	}
+
+	delete diag;
+}
@@ -0,0 +1,94 @@
+/*-
+ * Copyright (c) 2019 Hans Petter Selasky. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _MIDIPP_LATENCY_H_
+#define	_MIDIPP_LATENCY_H_
+
+#include "midipp.h"
+
+#define	MPP_LATENCY_SUB 8		/* sub-buckets per power of two */
+#define	MPP_LATENCY_BUCKETS (32 * MPP_LATENCY_SUB)
+#define	MPP_LATENCY_THREADS 8		/* per-thread histograms */
+
+enum {
+	MPP_LATENCY_LOCK_WAIT,
+	MPP_LATENCY_LOCK_HOLD,
+	MPP_LATENCY_RX_HANDLER,
+	MPP_LATENCY_RX_TO_TX,
+	MPP_LATENCY_MAX,
+};
+
+struct MppLatencyHist {
+	uint32_t bucket[MPP_LATENCY_BUCKETS];
+	uint32_t max;
+	uint64_t count;
+	uint64_t sum;
+};
+
+class MppLatency : public QObject
+{
+	Q_OBJECT;
+
+public:
+	MppLatency(MppMainWindow *);
+	~MppLatency();
+
+	static uint64_t now(void);
+
+	void record(int, uint64_t);
+	void lockAcquired(uint64_t);
+	void lockReleased(void);
+	void rxEvent(void);
+	void txEvent(void);
+	void txAlloc(uint32_t, uint32_t);
+
+	void reset(void);
+	QString toString(void);
+
+	MppMainWindow *mw;
+
+	MppGroupBox *gb_config;
+	QPlainTextEdit *txt_config;
+	QPushButton *but_refresh;
+	QPushButton *but_reset;
+	QPushButton *but_save;
+
+	struct MppLatencyHist hist[MPP_LATENCY_THREADS][MPP_LATENCY_MAX];
+
+	uint64_t alloc_events;
+	uint64_t alloc_bytes;
+	uint64_t alloc_stamp;
+	uint64_t rx_stamp;
+	uint64_t lock_stamp;
+	uint32_t lock_depth;
+	uint32_t threads;
+
+public slots:
+	void handle_refresh();
+	void handle_reset();
+	void handle_save();
+};
+
+#endif		/* _MIDIPP_LATENCY_H_ */
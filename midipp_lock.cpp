@@ -0,0 +1,89 @@
+/*-
+ * Copyright (c) 2019 Hans Petter Selasky. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "midipp_lock.h"
+
+MppLock :: MppLock(int _rank, const char *_name)
+{
+	umidi20_mutex_init(&mtx);
+	name = _name;
+	rank = _rank;
+	depth = 0;
+}
+
+MppLock :: ~MppLock()
+{
+	pthread_mutex_destroy(&mtx);
+}
+
+void
+MppLock :: lock(void)
+{
+	MppLockCheckAcquire(rank, name);
+	pthread_mutex_lock(&mtx);
+	depth++;
+}
+
+void
+MppLock :: unlock(void)
+{
+	depth--;
+	pthread_mutex_unlock(&mtx);
+	MppLockCheckRelease(rank);
+}
+
+#ifdef HAVE_LOCK_DEBUG
+static __thread uint32_t MppLockHeld[MPP_LOCK_MAX];
+static __thread const char *MppLockName[MPP_LOCK_MAX];
+
+void
+MppLockCheckAcquire(int rank, const char *name)
+{
+	if (rank < 0 || rank >= MPP_LOCK_MAX)
+		errx(1, "Invalid lock rank %d for %s", rank, name);
+
+	/* recursion is allowed */
+	if (MppLockHeld[rank] == 0) {
+		for (int x = rank + 1; x != MPP_LOCK_MAX; x++) {
+			if (MppLockHeld[x] == 0)
+				continue;
+			errx(1, "Lock order reversal: "
+			    "%s (rank %d) acquired while holding %s (rank %d)",
+			    name, rank, MppLockName[x], x);
+		}
+		MppLockName[rank] = name;
+	}
+	MppLockHeld[rank]++;
+}
+
+void
+MppLockCheckRelease(int rank)
+{
+	if (MppLockHeld[rank] == 0)
+		errx(1, "Lock %s (rank %d) released but not held",
+		    MppLockName[rank] ? MppLockName[rank] : "?", rank);
+	MppLockHeld[rank]--;
+}
+#endif
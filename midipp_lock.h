@@ -0,0 +1,78 @@
+/*-
+ * Copyright (c) 2019 Hans Petter Selasky. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _MIDIPP_LOCK_H_
+#define	_MIDIPP_LOCK_H_
+
+#include "midipp.h"
+
+/*
+ * Lock ranks. A thread may only acquire a lock having a higher rank
+ * than all the locks it already holds, except when re-entering a
+ * lock it already owns:
+ *
+ * MPP_LOCK_VIEW(n)	Score list, play position and settings of view
+ *			"n". Views are locked in ascending order. The
+ *			view settings are changed with the main lock
+ *			held too. Received key events are handled with
+ *			only the view lock held. The output functions
+ *			take the main lock themselves.
+ * MPP_LOCK_MAIN	The main lock, "MppMainWindow::mtx". Protects
+ *			the song, tracks, timing and key mode state.
+ *			Also used as the libumidi20 song mutex.
+ * MPP_LOCK_LOOP	Loop tab state.
+ *
+ * The TX callback, which is called with the libumidi20 root device
+ * mutex held, takes no locks. It only reads the atomic entries of
+ * the TX routing table, see "MppMainWindow::txRoute".
+ */
+#define	MPP_LOCK_VIEW(n)	(n)
+#define	MPP_LOCK_MAIN		MPP_MAX_VIEWS
+#define	MPP_LOCK_LOOP		(MPP_LOCK_MAIN + 1)
+#define	MPP_LOCK_MAX		(MPP_LOCK_LOOP + 1)
+
+class MppLock {
+public:
+	MppLock(int, const char *);
+	~MppLock();
+
+	void lock(void);
+	void unlock(void);
+
+	pthread_mutex_t mtx;
+	const char *name;
+	int rank;
+	int depth;	/* only accessed by the lock holder */
+};
+
+#ifdef HAVE_LOCK_DEBUG
+extern void MppLockCheckAcquire(int, const char *);
+extern void MppLockCheckRelease(int);
+#else
+#define	MppLockCheckAcquire(r, n) do { } while (0)
+#define	MppLockCheckRelease(r) do { } while (0)
+#endif
+
+#endif		/* _MIDIPP_LOCK_H_ */
@@ -30,16 +30,45 @@
 #include "midipp_mainwindow.h"
 #include "midipp_scores.h"
 #include "midipp_looptab.h"
+#include "midipp_lock.h"
 #include "midipp_spinbox.h"
 #include "midipp_button.h"
 #include "midipp_midi.h"
 #include "midipp_instrument.h"
 #include "midipp_groupbox.h"
 
+/*
+ * Copy all channel events of a loop track to the destination
+ * selected by check_play() or check_record(). The root device is
+ * locked once for the whole track, instead of once per event.
+ */
 static void
-mid_add_event(struct mid_data *d, struct umidi20_event *event)
+mid_add_track(struct mid_data *d, struct umidi20_track *track)
 {
-	event->position += d->position[0];
+	struct umidi20_event *event;
+	struct umidi20_event *event_copy;
+	struct umidi20_track *temp;
+
+	if (d->cc_enabled) {
+		/* copy unlocked into a scratch track */
+		temp = umidi20_track_alloc();
+		if (temp == 0)
+			return;
+	} else {
+		temp = d->track;
+	}
+
+	UMIDI20_QUEUE_FOREACH(event, &track->queue) {
+		if (~umidi20_event_get_what(event) & UMIDI20_WHAT_CHANNEL)
+			continue;
+		event_copy = umidi20_event_copy(event, 0);
+		if (event_copy == 0)
+			continue;
+		event_copy->position += d->position[0];
+
+		umidi20_event_queue_insert(&temp->queue,
+		    event_copy, UMIDI20_CACHE_INPUT);
+	}
 
 	if (d->cc_enabled) {
 		/*
@@ -47,12 +76,12 @@ mid_add_event(struct mid_data *d, struct umidi20_event *event)
 		 * entries to the play queue:
 		 */
 		pthread_mutex_lock(&(root_dev.mutex));
-		umidi20_event_queue_insert(&root_dev.play[d->cc_device_no].queue,
-		    event, UMIDI20_CACHE_INPUT);
+		umidi20_event_queue_move(&temp->queue,
+		    &root_dev.play[d->cc_device_no].queue, 0, 0-1, 0, 0-1,
+		    UMIDI20_CACHE_INPUT);
 		pthread_mutex_unlock(&(root_dev.mutex));
-	} else {
-		umidi20_event_queue_insert(&d->track->queue,
-		    event, UMIDI20_CACHE_INPUT);
+
+		umidi20_track_free(temp);
 	}
 }
 
@@ -61,10 +90,9 @@ MppLoopTabTimerCallback(void *arg)
 {
 	MppLoopTab *plt = (MppLoopTab *)arg;
 	uint32_t period = 0;
-	struct umidi20_event *event;
-	struct umidi20_event *event_copy;
 
 	plt->mw->atomic_lock();
+	plt->lock->lock();
 	for (int x = 0; x != MPP_LOOP_MAX; x++) {
 		if (plt->loop[x].state != MppLoopTab::ST_PLAYING)
 			continue;
@@ -77,6 +105,7 @@ MppLoopTabTimerCallback(void *arg)
 
 	if (period == 0 || plt->mw->midiTriggered == 0) {
 	  	umidi20_update_timer(&MppLoopTabTimerCallback, plt, 1, 0);
+		plt->lock->unlock();
 	  	plt->mw->atomic_unlock();		
 		return;
 	}
@@ -93,24 +122,19 @@ MppLoopTabTimerCallback(void *arg)
 
 		for (qreal n = 0; n != plt->loop[x].repeat_factor; n++) {
 			for (int z = 0; z != MPP_MAX_TRACKS; z++) {
-				UMIDI20_QUEUE_FOREACH(event, &plt->loop[x].track[z]->queue) {
-					if (~umidi20_event_get_what(event) & UMIDI20_WHAT_CHANNEL)
-						continue;
-					if (plt->mw->check_play(z, 0, base_off)) {
-						event_copy = umidi20_event_copy(event, 0);
-						if (event_copy != 0)
-							mid_add_event(&plt->mw->mid_data, event_copy);
-					}
-					if (plt->mw->check_record(z, 0, base_off)) {
-						event_copy = umidi20_event_copy(event, 0);
-						if (event_copy != 0)
-							mid_add_event(&plt->mw->mid_data, event_copy);
-					}
-				}
+				/* skip tracks without channel events */
+				if (!(plt->loop[x].tracks & (1U << z)))
+					continue;
+				/* the destination is the same for all events */
+				if (plt->mw->check_play(z, 0, base_off))
+					mid_add_track(&plt->mw->mid_data, plt->loop[x].track[z]);
+				if (plt->mw->check_record(z, 0, base_off))
+					mid_add_track(&plt->mw->mid_data, plt->loop[x].track[z]);
 			}
 			base_off += 2.0 * plt->loop[x].period * plt->loop[x].scale_factor;
 		}
 	}
+	plt->lock->unlock();
 	plt->mw->atomic_unlock();
 
 	umidi20_update_timer(&MppLoopTabTimerCallback, plt, 2 * period, 0);
@@ -120,9 +144,11 @@ void
 MppLoopTab :: handle_timer_sync()
 {
 	mw->atomic_lock();
+	lock->lock();
 	umidi20_update_timer(&MppLoopTabTimerCallback, this, 1, 1);
 	/* update alignment position */
 	pos_align = mw->get_time_offset();
+	lock->unlock();
 	mw->atomic_unlock();
 }
 
@@ -140,6 +166,8 @@ MppLoopTab :: MppLoopTab(QWidget *parent, MppMainWindow *_mw)
 
 	mw = _mw;
 
+	lock = new MppLock(MPP_LOCK_LOOP, "loop");
+
 	gl = new QGridLayout(this);
 
 	mbm_pedal_rec = new MppButtonMap("Record pedal\0" "OFF\0" "ON\0", 2, 2);
@@ -166,35 +194,36 @@ MppLoopTab :: MppLoopTab(QWidget *parent, MppMainWindow *_mw)
 	sli_progress->setDisabled(1);
 	gl->addWidget(sli_progress, 2, 1, 1, 2);
 
-#if MPP_LOOP_MAX != 16
-#error "This code needs an update"
-#endif
-	for (n = x = 0; x != 4; x++) {
-		for (y = 0; y != 4; y++, n++) {
-			for (z = 0; z != MPP_MAX_TRACKS; z++)
-				loop[n].track[z] = umidi20_track_alloc();
-			loop[n].sli_offset = new QSlider();
-			loop[n].sli_offset->setRange(0, 7);
-			loop[n].sli_offset->setOrientation(Qt::Horizontal);
-			loop[n].sli_offset->setValue(0);
-			loop[n].sli_offset->setToolTip(tr("Time offset for loop"));
-			gb_control->addWidget(loop[n].sli_offset, 2*x + 1, y, 1, 1);
-
-			loop[n].but_trig = new MppButton(
-			    tr("Loop %1\n"
-			       "IDLE :: 00.00\n").arg(n), n);
-			connect(loop[n].but_trig, SIGNAL(released(int)),
-			    this, SLOT(handle_trigger(int)));
-			gb_control->addWidget(loop[n].but_trig, 2*x + 0, y, 1, 1);
-		}
+	/* use a wider grid for many loops */
+	const int columns = (MPP_LOOP_MAX > 16) ? 8 : 4;
+
+	for (n = 0; n != MPP_LOOP_MAX; n++) {
+		x = n / columns;
+		y = n % columns;
+
+		for (z = 0; z != MPP_MAX_TRACKS; z++)
+			loop[n].track[z] = umidi20_track_alloc();
+		loop[n].sli_offset = new QSlider();
+		loop[n].sli_offset->setRange(0, 7);
+		loop[n].sli_offset->setOrientation(Qt::Horizontal);
+		loop[n].sli_offset->setValue(0);
+		loop[n].sli_offset->setToolTip(tr("Time offset for loop"));
+		gb_control->addWidget(loop[n].sli_offset, 2*x + 1, y, 1, 1);
+
+		loop[n].but_trig = new MppButton(
+		    tr("Loop %1\n"
+		       "IDLE :: 00.00\n").arg(n), n);
+		connect(loop[n].but_trig, SIGNAL(released(int)),
+		    this, SLOT(handle_trigger(int)));
+		gb_control->addWidget(loop[n].but_trig, 2*x + 0, y, 1, 1);
 	}
 	
 	gl->setRowStretch(1, 1);
 	gl->setColumnStretch(3, 1);
 
-	mw->atomic_lock();
+	lock->lock();
 	needs_update = 1;
-	mw->atomic_unlock();
+	lock->unlock();
 
 	handle_value_changed(0);
 
@@ -214,9 +243,11 @@ MppLoopTab :: ~MppLoopTab()
 			umidi20_track_free(loop[n].track[z]);
 	}
 	mw->atomic_unlock();
+
+	delete lock;
 }
 
-/* This function must be called locked */
+/* This function must be called with the main lock held */
 bool
 MppLoopTab :: check_record(uint8_t index, uint8_t chan, uint8_t n)
 {
@@ -224,8 +255,14 @@ MppLoopTab :: check_record(uint8_t index, uint8_t chan, uint8_t n)
 	uint32_t pos;
 
 	if (index >= MPP_MAX_TRACKS || chan >= 0x10 ||
-	    n >= MPP_LOOP_MAX || loop[n].state != ST_REC)
+	    n >= MPP_LOOP_MAX || mw->renderActive != 0)
+		return (false);
+
+	lock->lock();
+	if (loop[n].state != ST_REC) {
+		lock->unlock();
 		return (false);
+	}
 
 	pos = mw->get_time_offset();
 	if (pos == 0)
@@ -237,6 +274,7 @@ MppLoopTab :: check_record(uint8_t index, uint8_t chan, uint8_t n)
 	loop[n].last = pos;
 
 	needs_update = 1;
+	lock->unlock();
 
 	d->track = loop[n].track[index];
 	mid_set_channel(d, chan);
@@ -278,7 +316,7 @@ MppLoopTab :: handle_import(int n)
 	return (true);
 }
 
-/* Must be called locked */
+/* Must be called with the main and loop locks held */
 void
 MppLoopTab :: handle_recordN(int n)
 {
@@ -286,6 +324,7 @@ MppLoopTab :: handle_recordN(int n)
 	struct umidi20_event *temp;
 
 	loop[n].period = 0;
+	loop[n].tracks = 0;
 
 	for (int z = 0; z != MPP_MAX_TRACKS; z++) {
 		struct umidi20_event *first = 0;
@@ -303,6 +342,8 @@ MppLoopTab :: handle_recordN(int n)
 		}
 
 		UMIDI20_QUEUE_FOREACH(event, &loop[n].track[z]->queue) {
+			if (umidi20_event_get_what(event) & UMIDI20_WHAT_CHANNEL)
+				loop[n].tracks |= (1U << z);
 			if (umidi20_event_is_key_start(event)) {
 				if (first == 0) {
 					first = event;
@@ -358,12 +399,15 @@ MppLoopTab :: handle_trigger(int n)
 		return;
 
 	mw->atomic_lock();
+	lock->lock();
 	switch (loop[n].state) {
 	case ST_IDLE:
 		loop[n].state = ST_REC;
+		armed |= (1ULL << n);
 		break;
 	case ST_REC:
 		loop[n].state = ST_PLAYING;
+		armed &= ~(1ULL << n);
 		handle_recordN(n);
 		break;
 	case ST_PLAYING:
@@ -376,6 +420,7 @@ MppLoopTab :: handle_trigger(int n)
 		break;
 	}
 	needs_update = 1;
+	lock->unlock();
 	mw->atomic_unlock();
 }
 
@@ -390,13 +435,15 @@ MppLoopTab :: handle_clear(int n)
 	mbm_arm_reset->setSelection(0);
 
 	mw->atomic_lock();
+	lock->lock();
 	handle_clearN(n);
+	lock->unlock();
 	mw->atomic_unlock();
 
 	return (true);
 }
 
-/* Must be called locked */
+/* Must be called with the main and loop locks held */
 void
 MppLoopTab :: handle_clearN(int n)
 {
@@ -404,9 +451,11 @@ MppLoopTab :: handle_clearN(int n)
 		umidi20_event_queue_drain(&loop[n].track[z]->queue);
 
 	loop[n].state = ST_IDLE;
+	armed &= ~(1ULL << n);
 	loop[n].first = 0;
 	loop[n].last = 0;
 	loop[n].period = 0;
+	loop[n].tracks = 0;
 
 	needs_update = 1;
 }
@@ -417,8 +466,10 @@ MppLoopTab :: handle_reset()
 	int n;
 
 	mw->atomic_lock();
+	lock->lock();
 	for (n = 0; n != MPP_LOOP_MAX; n++)
 		handle_clearN(n);
+	lock->unlock();
 	mw->atomic_unlock();
 
 	mbm_pedal_rec->setSelection(0);
@@ -435,9 +486,9 @@ MppLoopTab :: handle_value_changed(int dummy)
 void
 MppLoopTab :: handle_pedal_rec(int value)
 {
-	mw->atomic_lock();
+	lock->lock();
 	pedal_rec = value;
-	mw->atomic_unlock();
+	lock->unlock();
 }
 
 void
@@ -449,12 +500,12 @@ MppLoopTab :: watchdog()
 	char buf_dur[16];
 	const char *pbuf;
 
-	mw->atomic_lock();
+	lock->lock();
 	n = needs_update;
 	needs_update = 0;
 
 	if (cur_period != 0) {
-		uint32_t pos = mw->get_time_offset();
+		uint32_t pos = mw->get_time_offset_snapshot();
 		if (pos == 0)
 			pos = 1;
 		num = (1000 * (pos - pos_align)) / cur_period;
@@ -463,7 +514,7 @@ MppLoopTab :: watchdog()
 	} else {
 		num = 0;
 	}
-	mw->atomic_unlock();
+	lock->unlock();
 
 	sli_progress->setValue(num);
 
@@ -472,7 +523,7 @@ MppLoopTab :: watchdog()
 
 	for (n = 0; n != MPP_LOOP_MAX; n++) {
 
-		mw->atomic_lock();
+		lock->lock();
 
 		if (loop[n].period == 0)
 			dur = (loop[n].last - loop[n].first) / 10;
@@ -497,7 +548,7 @@ MppLoopTab :: watchdog()
 			break;
 		}
 
-		mw->atomic_unlock();
+		lock->unlock();
 
 		loop[n].but_trig->setText(
 		    tr("Loop %1\n" "%2 :: %3\n").arg(n).arg(pbuf).arg(buf_dur));
@@ -28,6 +28,10 @@
 
 #include "midipp.h"
 
+#if (MPP_LOOP_MAX < 1) || (MPP_LOOP_MAX > 64)
+#error "MPP_LOOP_MAX must be in the range 1..64"
+#endif
+
 struct MppLoopEntry {
 	MppButton *but_trig;
 	QSlider *sli_offset;
@@ -38,6 +42,7 @@ struct MppLoopEntry {
 	uint32_t first;
 	uint32_t last;
 	uint32_t state;
+	uint32_t tracks;	/* tracks having channel events */
 };
 
 class MppLoopTab : public QWidget
@@ -64,6 +69,12 @@ public:
 
 	MppMainWindow *mw;
 
+	/*
+	 * Protects the loop state, the alignment and the update
+	 * flag. The loop tracks are protected by the main lock.
+	 */
+	MppLock *lock;
+
 	QGridLayout *gl;
 
 	MppGroupBox *gb_control;
@@ -77,6 +88,13 @@ public:
 
 	struct MppLoopEntry loop[MPP_LOOP_MAX];
 
+	/*
+	 * Mask of loops in the recording state. Changed with both
+	 * the main and loop locks held, so that it can be read with
+	 * only the main lock held.
+	 */
+	uint64_t armed;
+
 	uint32_t pos_align;
 	uint32_t cur_period;
   
@@ -41,6 +41,10 @@
 #include "midipp_groupbox.h"
 #include "midipp_gridlayout.h"
 #include "midipp_midi.h"
+#include "midipp_midiconv.h"
+#include "midipp_midiload.h"
+#include "midipp_midisave.h"
+#include "midipp_midijournal.h"
 #include "midipp_mode.h"
 #include "midipp_settings.h"
 #include "midipp_checkbox.h"
@@ -56,9 +60,17 @@
 #include "midipp_sheet.h"
 #include "midipp_musicxml.h"
 #include "midipp_instrument.h"
+#include "midipp_latency.h"
+#include "midipp_lock.h"
+#include "midipp_ring.h"
+#include "midipp_record.h"
 #include "midipp_volume.h"
 #include "midipp_devsel.h"
 
+/* chord window for score recording, in milliseconds */
+static const uint8_t MppScoreWindow[] = { 20, 40, 80, 160 };
+
+/* can be called with only a view lock held */
 uint8_t
 MppMainWindow :: noise8(uint8_t factor)
 {
@@ -68,12 +80,14 @@ MppMainWindow :: noise8(uint8_t factor)
 	if (factor == 0)
 		return (0);
 
+	atomic_lock();
 	if (noiseRem & 1)
 		noiseRem += prime;
 
 	noiseRem /= 2;
 
 	temp = noiseRem * factor;
+	atomic_unlock();
 
 	return (temp >> 24);
 }
@@ -90,6 +104,12 @@ MppMainWindow :: MppMainWindow(QWidget *parent)
 
 	umidi20_mutex_init(&mtx);
 
+	latency = new MppLatency(this);
+
+	scoreRec = new MppRecord();
+	scoreWindow = MppScoreWindow[1];
+	controlEvents = new MppRing(MPP_MAX_QUEUE);
+
 	noiseRem = 1;
 
 	defaultFont.fromString(QString("Sans Serif,-1,20,5,75,0,0,0,0,0"));
@@ -364,6 +384,16 @@ MppMainWindow :: MppMainWindow(QWidget *parent)
 		connect(but_midi_file_import[x], SIGNAL(released(int)), this, SLOT(handle_midi_file_import(int)));
 	}
 
+	for (x = 0; x != MPP_MAX_VIEWS; x++) {
+		but_midi_file_render[x] = new MppButton(QString("Render\n" "%1-Scores").arg(QChar('A' + x)), x);
+		gb_midi_file->addWidget(but_midi_file_render[x], 7 + MPP_MAX_VIEWS + x, 0, 1, 1);
+		connect(but_midi_file_render[x], SIGNAL(released(int)), this, SLOT(handle_midi_file_render(int)));
+	}
+
+	but_midi_file_journal = new QPushButton(tr("Record\nto journal"));
+	gb_midi_file->addWidget(but_midi_file_journal, 7 + 2 * MPP_MAX_VIEWS, 0, 1, 1);
+	connect(but_midi_file_journal, SIGNAL(released()), this, SLOT(handle_midi_file_journal()));
+
 	gb_gpro_file_import = new MppGroupBox(tr("GPro v3/4"));
 
 	for (x = 0; x != MPP_MAX_VIEWS; x++) {
@@ -442,6 +472,10 @@ MppMainWindow :: MppMainWindow(QWidget *parent)
 	mbm_score_record = new MppButtonMap("Score recording\0" "OFF\0" "ON\0" "ONE\0", 3, 3);
 	connect(mbm_score_record, SIGNAL(selectionChanged(int)), this, SLOT(handle_score_record(int)));
 
+	mbm_score_window = new MppButtonMap("Score recording chord window\0" "20ms\0" "40ms\0" "80ms\0" "160ms\0", 4, 4);
+	mbm_score_window->setSelection(1);
+	connect(mbm_score_window, SIGNAL(selectionChanged(int)), this, SLOT(handle_score_window(int)));
+
 	mbm_key_mode_a = new MppKeyModeButtonMap("Input key mode for view A");
 	connect(mbm_key_mode_a, SIGNAL(selectionChanged(int)), this, SLOT(handle_key_mode_a(int)));
 
@@ -464,6 +498,7 @@ MppMainWindow :: MppMainWindow(QWidget *parent)
 	tab_play_gl->addWidget(dlg_bpm->mbm_generator, 2,2,1,1);
 	tab_play_gl->addWidget(gl_bpm, 3,2,1,2);
 
+	tab_play_gl->addWidget(mbm_score_window, 4,2,1,1);
 	tab_play_gl->addWidget(gl_tuning, 4,3,1,1);
 
 	tab_play_gl->setRowStretch(5, 1);
@@ -556,6 +591,7 @@ MppMainWindow :: MppMainWindow(QWidget *parent)
 
 	x++;
 
+	tab_config_gl->addWidget(latency->gb_config, x, 0, 1, 8);
 	tab_config_gl->setRowStretch(x, 1);
 
 	x++;
@@ -616,6 +652,26 @@ MppMainWindow :: ~MppMainWindow()
 	watchdog->stop();
 	tim_config_apply->stop();
 
+	/* finish pending file write, if any */
+	if (midiSave != NULL) {
+		midiSave->wait();
+		delete midiSave;
+	}
+
+	/* finalize the journal, if any */
+	if (midiJournal != NULL) {
+		MppMidiJournal *journal;
+
+		atomic_lock();
+		journal = midiJournal;
+		midiJournal = NULL;
+		journal->finish();
+		atomic_unlock();
+
+		journal->wait();
+		delete journal;
+	}
+
 	MidiUnInit();
 }
 
@@ -631,21 +687,26 @@ MppMainWindow :: handle_quit()
 	QCoreApplication::exit(0);
 }
 
+/* must be called with the views given by "views" locked */
 void
-MppMainWindow :: handle_jump_locked(int index)
+MppMainWindow :: handle_jump_locked(int index, uint32_t views)
 {
 	int x;
 
-	for (x = 0; x != MPP_MAX_VIEWS; x++)
-		scores_main[x]->handleLabelJump(index);
+	for (x = 0; x != MPP_MAX_VIEWS; x++) {
+		if (views & (1U << x))
+			scores_main[x]->handleLabelJump(index);
+	}
 }
 
 void
 MppMainWindow :: handle_jump(int index)
 {
+	atomic_lock_views();
 	atomic_lock();
-	handle_jump_locked(index);
+	handle_jump_locked(index, (1U << MPP_MAX_VIEWS) - 1);
 	atomic_unlock();
+	atomic_unlock_views();
 }
 
 void
@@ -658,9 +719,11 @@ MppMainWindow :: handle_compile(int force)
 		y += scores_main[x]->handleCompile(force);
 
 	if (y != 0) {
+		atomic_lock_views();
 		atomic_lock();
 		handle_stop();
 		atomic_unlock();
+		atomic_unlock_views();
 	}
 }
 
@@ -669,9 +732,17 @@ MppMainWindow :: handle_score_record(int value)
 {
 	atomic_lock();
 	scoreRecordOn = value;
+	if (value == 0)
+		scoreRec->reset();
 	atomic_unlock();
 }
 
+void
+MppMainWindow :: handle_score_window(int value)
+{
+	scoreWindow = MppScoreWindow[value];
+}
+
 void
 MppMainWindow :: handle_midi_pause()
 {
@@ -738,10 +809,13 @@ MppMainWindow :: handle_play_press(int key, int which)
 	if (which < 0 || which >= MPP_MAX_VIEWS)
 		which = 0;
 
-	atomic_lock();
 	MppScoreMain *sm = scores_main[which];
+
+	sm->atomicLock();
+	atomic_lock();
 	sm->handleMidiKeyPressLocked(key, 90);
 	atomic_unlock();
+	sm->atomicUnlock();
 }
 
 void
@@ -752,9 +826,11 @@ MppMainWindow :: handle_play_release(int key, int which)
 
 	MppScoreMain *sm = scores_main[which];
 
+	sm->atomicLock();
 	atomic_lock();
 	sm->handleMidiKeyReleaseLocked(key, 90);
 	atomic_unlock();
+	sm->atomicUnlock();
 }
 
 void
@@ -765,9 +841,11 @@ MppMainWindow :: handle_sustain_press(int which)
 
 	MppScoreMain *sm = scores_main[which];
 
+	sm->atomicLock();
 	atomic_lock();
 	sm->outputControl(0x40, 127);
 	atomic_unlock();
+	sm->atomicUnlock();
 }
 
 void
@@ -778,20 +856,22 @@ MppMainWindow :: handle_sustain_release(int which)
 
 	MppScoreMain *sm = scores_main[which];
 
+	sm->atomicLock();
 	atomic_lock();
 	sm->outputControl(0x40, 0);
 	atomic_unlock();
+	sm->atomicUnlock();
 }
 
 void
 MppMainWindow :: handle_watchdog_sub(MppScoreMain *sm, int update_cursor)
 {
 	QTextCursor cursor(sm->editWidget->textCursor());
+	struct MppPlayState ps;
 	int play_line;
 
-	atomic_lock();
-	play_line = sm->head.getCurrLine();
-	atomic_unlock();
+	sm->getPlayState(&ps);
+	play_line = ps.curr_line;
 
 	if (update_cursor) {
 		cursor.movePosition(QTextCursor::Start, QTextCursor::MoveAnchor, 1);
@@ -808,15 +888,9 @@ MppMainWindow :: handle_watchdog_sub(MppScoreMain *sm, int update_cursor)
 void
 MppMainWindow :: handle_watchdog()
 {
-	uint32_t delta;
+	uint32_t value;
 	int bpm;
-	char buf[32];
-	uint8_t events_copy[MPP_MAX_QUEUE][4];
-	uint8_t num_events;
-	uint8_t x;
-	uint8_t y;
-	uint8_t z;
-	uint8_t last_duration;
+	uint32_t x;
 	uint8_t instr_update;
 	uint8_t cursor_update;
 	uint8_t key_mode_update;
@@ -825,89 +899,56 @@ MppMainWindow :: handle_watchdog()
 	/* update focus if any */
 	handle_tab_changed();
 
-	atomic_lock();
-	cursor_update = cursorUpdate;
-	cursorUpdate = 0;
-	instr_update = instrUpdated;
-	instrUpdated = 0;
-	num_events = numInputEvents;
-	key_mode_update = keyModeUpdated;
-	keyModeUpdated = 0;
-	ops = doOperation;
-	doOperation = 0;
-	bpm = dlg_bpm->bpm_other;
-
-	if (num_events != 0) {
-		delta =  umidi20_get_curr_position() - lastInputEvent;
-		if (delta >= ((UMIDI20_BPM + 60 - 1) / 60)) {
-			numInputEvents = 0;
-			memcpy(events_copy, inputEvents, num_events);
-		} else {
-			/* wait until 1 second has elapsed */
-			num_events = 0;
-		}
-	}
-	if (num_events != 0) {
+	/* the update flags are read and cleared atomically */
+	cursor_update = __atomic_exchange_n(&cursorUpdate, 0, __ATOMIC_ACQ_REL);
+	instr_update = __atomic_exchange_n(&instrUpdated, 0, __ATOMIC_ACQ_REL);
+	key_mode_update = __atomic_exchange_n(&keyModeUpdated, 0, __ATOMIC_ACQ_REL);
+	ops = __atomic_exchange_n(&doOperation, 0, __ATOMIC_ACQ_REL);
+	bpm = __atomic_load_n(&dlg_bpm->bpm_other, __ATOMIC_RELAXED);
 
+	/* hand recorded events over to the journal writer */
+	if (midiJournal != NULL) {
+		atomic_lock();
+		midiJournal->collect();
 		atomic_unlock();
+	}
 
-		QPlainTextEdit *ped = currEditor();
-		QTextCursor cursor;
-
-		mid_sort(events_copy[0], num_events);
-
-		last_duration = 0;
-
-		if (ped != 0) {
-			cursor = QTextCursor(ped->textCursor());
-			cursor.movePosition(QTextCursor::StartOfLine, QTextCursor::MoveAnchor, 1);
-			cursor.beginEditBlock();
-		}
-
-		for (x = 0; x != num_events; x++) {
-			for (y = x; y != num_events; y++) {
-				if (events_copy[0][x] != events_copy[0][y])
-					break;
-			}
+	/* the recorded keys are handed over in constant time */
+	if (__atomic_load_n(&scoreRecordOn, __ATOMIC_RELAXED) != 0) {
+		QString text;
 
-			z = y - 1;
-			y = y - x;
+		atomic_lock();
+		scoreRec->swap();
+		atomic_unlock();
 
-			if (y != last_duration) {
-				last_duration = y;
-				snprintf(buf, sizeof(buf), "U%d %s ",
-				    y, mid_key_str[events_copy[0][x] & 0x7F]);
-			} else {
-				snprintf(buf, sizeof(buf), "%s ",
-				    mid_key_str[events_copy[0][x] & 0x7F]);
-			}
+		if (scoreRec->process(text, umidi20_get_curr_position(),
+		    scoreWindow, (bpm > 0) ? bpm : 0)) {
+			QPlainTextEdit *ped = currEditor();
 
+			/* the complete lines are inserted in one go */
 			if (ped != 0) {
-				cursor.insertText(QString(buf));
+				QTextCursor cursor(ped->textCursor());
+
+				cursor.movePosition(QTextCursor::StartOfLine, QTextCursor::MoveAnchor, 1);
+				cursor.beginEditBlock();
+				cursor.insertText(text);
+				cursor.endEditBlock();
+				ped->setTextCursor(cursor);
 			}
-			x = z;
-		}
 
-		if (ped != 0) {
-			cursor.insertText(QString("\n"));
-			cursor.endEditBlock();
-			ped->setTextCursor(cursor);
+			if (scoreRecordOn == 2)
+				mbm_score_record->setSelection(0);
 		}
-
-		if (scoreRecordOn == 2)
-			mbm_score_record->setSelection(0);
-
-		atomic_lock();
 	}
-	num_events = numControlEvents;
-	if (num_events != 0) {
-		numControlEvents = 0;
-		memcpy(events_copy, controlEvents, num_events * sizeof(controlEvents[0]));
-	}
-	atomic_unlock();
 
-	for (x = 0; x != num_events; x++) {
-		tab_shortcut->handle_record_event(events_copy[x]);
+	while (controlEvents->pop(&value)) {
+		uint8_t cmd[4] = {
+			(uint8_t)(value & 0xFF),
+			(uint8_t)((value >> 8) & 0xFF),
+			(uint8_t)((value >> 16) & 0xFF),
+			(uint8_t)((value >> 24) & 0xFF),
+		};
+		tab_shortcut->handle_record_event(cmd);
 	}
 
 	if (instr_update)
@@ -1021,12 +1062,7 @@ MppMainWindow :: handle_midi_file_open(int how)
 	  new QFileDialog(this, tr("Select MIDI File"), 
 		Mpp.HomeDirMid,
 		QString("MIDI File (*.mid *.MID)"));
-	struct umidi20_song *song_copy;
-	struct umidi20_track *track_copy;
-	struct umidi20_event *event;
-	struct umidi20_event *event_copy;
-	QByteArray data;
-	unsigned int x;
+	MppMidiLoad *load = NULL;
 
 	diag->setAcceptMode(QFileDialog::AcceptOpen);
 	diag->setFileMode(QFileDialog::ExistingFile);
@@ -1044,27 +1080,32 @@ MppMainWindow :: handle_midi_file_open(int how)
 
 		CurrMidiFileName = new QString(diag->selectedFiles()[0]);
 
-		if (MppReadRawFile(*CurrMidiFileName, &data) == 0) {
-		
-			atomic_lock();
-			song_copy = umidi20_load_file(&mtx,
-			    (const uint8_t *)data.data(), data.size());
-			atomic_unlock();
+		/* read and parse without holding any locks */
+		load = new MppMidiLoad(*CurrMidiFileName, how);
+		load->start();
 
-			if (song_copy == NULL) {
-				QMessageBox box;
+		if (load->wait(250) == false) {
+			QProgressDialog progress(tr("Loading MIDI file"),
+			    QString(), 0, 0, this);
 
-				box.setText(tr("Invalid MIDI file!"));
-				box.setStandardButtons(QMessageBox::Ok);
-				box.setIcon(QMessageBox::Information);
-				box.setWindowIcon(QIcon(MppIconFile));
-				box.setWindowTitle(MppVersion);
-				box.exec();
-			} else {
-				goto load_file;
-			}
-		} else {
-			song_copy = NULL;
+			progress.setWindowModality(Qt::WindowModal);
+			progress.setMinimumDuration(0);
+
+			while (load->wait(50) == false)
+				progress.setValue(0);
+		}
+
+		if (load->error == MPP_MIDILOAD_OK) {
+			goto load_file;
+		} else if (load->error != MPP_MIDILOAD_ERR_READ) {
+			QMessageBox box;
+
+			box.setText(tr("Invalid MIDI file!"));
+			box.setStandardButtons(QMessageBox::Ok);
+			box.setIcon(QMessageBox::Information);
+			box.setWindowIcon(QIcon(MppIconFile));
+			box.setWindowTitle(MppVersion);
+			box.exec();
 		}
 	}
 
@@ -1072,48 +1113,12 @@ MppMainWindow :: handle_midi_file_open(int how)
 
 load_file:
 
-	printf("format %d\n", song_copy->midi_file_format);
-	printf("resolution %d\n", song_copy->midi_resolution);
-	printf("division_type %d\n", song_copy->midi_division_type);
+	printf("format %d\n", load->song->midi_file_format);
+	printf("resolution %d\n", load->song->midi_resolution);
+	printf("division_type %d\n", load->song->midi_division_type);
 
 	atomic_lock();
-
-	x = 0;
-	UMIDI20_QUEUE_FOREACH(track_copy, &song_copy->queue) {
-
-	    UMIDI20_QUEUE_FOREACH(event, &track_copy->queue) {
-
-	        if (umidi20_event_is_voice(event) ||
-		    umidi20_event_is_sysex(event)) {
-
-		    if (do_instr_check(event, NULL) != 0) {
-			event_copy = NULL;
-		    } else {
-			event_copy = umidi20_event_copy(event, 0);
-		    }
-		} else if (umidi20_event_get_what(event) &
-		    (UMIDI20_WHAT_SONG_EVENT | UMIDI20_WHAT_BEAT_EVENT)) {
-			event_copy = umidi20_event_copy(event, 0);
-		} else {
-			event_copy = NULL;
-		}
-
-		if (event_copy != NULL) {
-			/* reserve low positions for channel program events */
-			if (event_copy->position < MPP_MIN_POS)
-				event_copy->position = MPP_MIN_POS;
-			umidi20_event_queue_insert(&track[x]->queue,
-			    event_copy, UMIDI20_CACHE_INPUT);
-		}
-	    }
-	    if ((how & 2) && ++x == MPP_MAX_TRACKS)
-		break;
-	}
-
-	umidi20_song_free(song_copy);
-
-	update_play_device_no();
-
+	load->attach(this);
 	atomic_unlock();
 
 	if (how & 4)
@@ -1123,12 +1128,14 @@ done:
 	if (how & (4 | 1))
 		handle_midi_file_clear_name();
 
+	/* the detached song is freed unlocked */
+	delete load;
 	delete diag;
 }
 
 /* must be called locked */
 void
-MppMainWindow :: handle_midi_file_instr_prepend()
+MppMainWindow :: handle_midi_file_instr_prepend(struct umidi20_track **ptrack)
 {
 	struct mid_data *d = &mid_data;
 	uint8_t x;
@@ -1136,7 +1143,7 @@ MppMainWindow :: handle_midi_file_instr_prepend()
 
 	for (n = 0; n != MPP_MAX_TRACKS; n++) {
 		for (x = 0; x != 16; x++) {
-			d->track = track[n];
+			d->track = ptrack[n];
 			mid_set_channel(d, x);
 			mid_set_position(d, 0);
 			mid_set_device_no(d, 0xFF);
@@ -1147,62 +1154,63 @@ MppMainWindow :: handle_midi_file_instr_prepend()
 	}
 }
 
-/* must be called locked */
-void
-MppMainWindow :: handle_midi_file_instr_delete()
-{
-	for (unsigned int x = 0; x != MPP_MAX_TRACKS; x++) {
-		umidi20_event_queue_move(&track[x]->queue, NULL, 0,
-		    MPP_MIN_POS, 0, 0-1, UMIDI20_CACHE_INPUT);
-	}
-}
-
 void
 MppMainWindow :: handle_midi_file_save()
 {
-	uint8_t *data;
-	uint32_t len;
-	uint8_t status;
-
 	if (CurrMidiFileName != NULL) {
 
+		/* only one save at a time */
+		if (midiSave != NULL) {
+			midiSave->wait();
+			handle_midi_file_save_done();
+		}
+
+		midiSave = new MppMidiSave(*CurrMidiFileName);
+
 		atomic_lock();
-		handle_midi_file_instr_prepend();
-		status = umidi20_save_file(song, &data, &len);
-		handle_midi_file_instr_delete();
+		midiSave->snapshot(this);
 		atomic_unlock();
 
-		if (status == 0) {
-			QByteArray qdata = QByteArray::
-			    fromRawData((const char *)data, len);
+		/* encode and write without holding any locks */
+		connect(midiSave, SIGNAL(finished()), this, SLOT(handle_midi_file_save_done()));
+		midiSave->start();
+	} else {
+		handle_midi_file_save_as();
+	}
+}
 
-			status = MppWriteRawFile(*CurrMidiFileName, &qdata);
+void
+MppMainWindow :: handle_midi_file_save_done()
+{
+	int error;
 
-			free(data);
+	/* ignore stale signals from an already collected save */
+	if (midiSave == NULL || midiSave->isFinished() == false)
+		return;
 
-			if (status) {
-				QMessageBox box;
+	error = midiSave->error;
+	delete midiSave;
+	midiSave = NULL;
 
-				box.setText(tr("Could not write MIDI file!"));
-				box.setStandardButtons(QMessageBox::Ok);
-				box.setIcon(QMessageBox::Information);
-				box.setWindowIcon(QIcon(MppIconFile));
-				box.setWindowTitle(MppVersion);
-				box.exec();
-			}
-		} else {
-			QMessageBox box;
+	if (error == MPP_MIDISAVE_ERR_WRITE) {
+		QMessageBox box;
 
-			box.setText(tr("Could not get MIDI data!"));
-			box.setStandardButtons(QMessageBox::Ok);
-			box.setIcon(QMessageBox::Information);
-			box.setWindowIcon(QIcon(MppIconFile));
-			box.setWindowTitle(MppVersion);
+		box.setText(tr("Could not write MIDI file!"));
+		box.setStandardButtons(QMessageBox::Ok);
+		box.setIcon(QMessageBox::Information);
+		box.setWindowIcon(QIcon(MppIconFile));
+		box.setWindowTitle(MppVersion);
+		box.exec();
+	} else if (error != MPP_MIDISAVE_OK) {
+		QMessageBox box;
 
-			box.exec();
-		}
-	} else {
-		handle_midi_file_save_as();
+		box.setText(tr("Could not get MIDI data!"));
+		box.setStandardButtons(QMessageBox::Ok);
+		box.setIcon(QMessageBox::Information);
+		box.setWindowIcon(QIcon(MppIconFile));
+		box.setWindowTitle(MppVersion);
+
+		box.exec();
 	}
 }
 
@@ -1235,91 +1243,414 @@ MppMainWindow :: handle_midi_file_save_as()
 }
 
 void
-MppMainWindow :: handle_rewind()
+MppMainWindow :: handle_midi_file_journal()
 {
-	if (midiTriggered != 0) {
+	MppMidiJournal *journal;
+	QString fname;
+	int error;
+
+	if (midiJournal != NULL) {
 		atomic_lock();
-		/* kill all leftover notes */
-		handle_stop();
-		/* send song stop event */
-		send_song_stop_locked();
+		journal = midiJournal;
+		midiJournal = NULL;
+		journal->finish();
 		atomic_unlock();
 
-		/* wait for MIDI events to propagate */
-		MppSleep::msleep(100 /* ms */);
+		/* the remaining events are written by the journal thread */
+		journal->wait();
+		error = journal->error;
+		delete journal;
+
+		but_midi_file_journal->setText(tr("Record\nto journal"));
+
+		if (error != MPP_MIDIJOURNAL_OK) {
+			QMessageBox box;
+
+			box.setText(tr("Could not write MIDI journal!"));
+			box.setStandardButtons(QMessageBox::Ok);
+			box.setIcon(QMessageBox::Information);
+			box.setWindowIcon(QIcon(MppIconFile));
+			box.setWindowTitle(MppVersion);
+			box.exec();
+		}
+		return;
 	}
 
-	atomic_lock();
+	QFileDialog *diag = 
+	  new QFileDialog(this, tr("Select MIDI File"), 
+		Mpp.HomeDirMid,
+		QString("MIDI File (*.mid *.MID)"));
 
-	midiTriggered = 0;
-	midiPaused = 0;
-	pausePosition = 0;
+	diag->setAcceptMode(QFileDialog::AcceptSave);
+	diag->setFileMode(QFileDialog::AnyFile);
+	diag->setDefaultSuffix(QString("mid"));
 
-	update_play_device_no();
+	if (diag->exec()) {
 
-	if (song != NULL) {
-		umidi20_song_stop(song,
-		    UMIDI20_FLAG_PLAY | UMIDI20_FLAG_RECORD);
-		umidi20_song_start(song, 0x40000000, 0x80000000,
-		    UMIDI20_FLAG_PLAY | UMIDI20_FLAG_RECORD);
-		startPosition = umidi20_get_curr_position() - 0x40000000;
-	}
-	atomic_unlock();
-}
+		Mpp.HomeDirMid = diag->directory().path();
 
-void
-MppMainWindow :: handle_midi_trigger()
-{
-	atomic_lock();
+		fname = diag->selectedFiles()[0];
 
-	if (midiTriggered == 0) {
-		if (midiPlayOff == 0) {
-			umidi20_song_stop(song,
-			    UMIDI20_FLAG_PLAY | UMIDI20_FLAG_RECORD);
-			umidi20_song_start(song, pausePosition, 0x40000000,
-			    UMIDI20_FLAG_PLAY | UMIDI20_FLAG_RECORD);
-			startPosition = umidi20_get_curr_position() - pausePosition;
-		} else {
-			umidi20_song_stop(song,
-			    UMIDI20_FLAG_PLAY | UMIDI20_FLAG_RECORD);
-			umidi20_song_start(song, 0x40000000 + pausePosition, 0x80000000,
-			    UMIDI20_FLAG_PLAY | UMIDI20_FLAG_RECORD);
-			startPosition = umidi20_get_curr_position() - 0x40000000 - pausePosition;
-		}
+		if (QFile::exists(MppMidiJournal::journalName(fname))) {
+			QString rname = MppMidiJournal::recoveredName(fname);
+			QMessageBox box;
 
-		/* cleanup old pending playback events */
-		for (unsigned x = 0; x != MPP_MAX_TRACKS; x++) {
-			struct umidi20_event *event;
-			struct umidi20_event *temp;
+			box.setText(tr("An interrupted recording of the "
+			    "selected MIDI file was found. Recover it into "
+			    "%1 before recording?").arg(rname));
+			if (QFile::exists(rname)) {
+				box.setInformativeText(tr("The existing "
+				    "file will be overwritten! Otherwise the "
+				    "interrupted recording is discarded."));
+			} else {
+				box.setInformativeText(tr("Otherwise the "
+				    "interrupted recording is discarded."));
+			}
+			box.setStandardButtons(QMessageBox::Yes |
+			    QMessageBox::No | QMessageBox::Cancel);
+			box.setDefaultButton(QMessageBox::Yes);
+			box.setIcon(QMessageBox::Question);
+			box.setWindowIcon(QIcon(MppIconFile));
+			box.setWindowTitle(MppVersion);
 
-			UMIDI20_QUEUE_FOREACH_SAFE(event, &track[x]->queue, temp) {
-				if (event->position >= 0x40000000) {
-					UMIDI20_IF_REMOVE(&track[x]->queue, event);
-					umidi20_event_free(event);
-				}
+			switch (box.exec()) {
+			case QMessageBox::Yes:
+				if (MppMidiJournal::recover(fname, rname))
+					break;
+				box.setText(tr("Could not recover the "
+				    "interrupted recording!"));
+				box.setInformativeText(QString());
+				box.setStandardButtons(QMessageBox::Ok);
+				box.setIcon(QMessageBox::Information);
+				box.exec();
+				goto done;
+			case QMessageBox::No:
+				break;
+			default:
+				goto done;
 			}
 		}
 
-		/* XXX first recursion point */
-		send_song_trigger_locked();
+		journal = new MppMidiJournal(fname);
 
-		midiTriggered = 1;
-		midiPaused = 0;
-		pausePosition = 0;
+		if (journal->open() == false) {
+			QMessageBox box;
 
-		dlg_bpm->handle_update(1);
-		tab_replay->metronome->handleUpdateLocked();
-		tab_loop->handle_timer_sync();
+			delete journal;
+
+			box.setText(tr("Could not write MIDI journal!"));
+			box.setStandardButtons(QMessageBox::Ok);
+			box.setIcon(QMessageBox::Information);
+			box.setWindowIcon(QIcon(MppIconFile));
+			box.setWindowTitle(MppVersion);
+			box.exec();
+		} else {
+			journal->start();
+
+			atomic_lock();
+			midiJournal = journal;
+			atomic_unlock();
+
+			but_midi_file_journal->setText(tr("Stop\njournal"));
+		}
 	}
-	atomic_unlock();
+done:
+	delete diag;
 }
 
+/* must be called locked */
 void
-MppMainWindow :: handle_config_reload()
-{
-	struct umidi20_config cfg;
-	char *p_play;
-	char *p_rec;
+MppMainWindow :: handle_render_locked(MppScoreMain *sm)
+{
+	uint8_t state[sizeof(sm->head.state)];
+	struct MppExtKey ext_key[MPP_EXT_KEYS];
+	uint8_t ext_hash[MPP_EXT_HASH];
+	struct MppMpeChan mpe_chan[MPP_MPE_CHANNELS];
+	MppPressed *pressed;
+	MppElement *start;
+	MppElement *stop;
+	MppElement *first;
+	uint32_t noise;
+	uint32_t mpe_seq;
+	uint32_t period;
+	uint32_t duty_ticks;
+	uint32_t max_beats;
+	uint32_t n;
+	int key_locked;
+	int vel;
+	int key;
+	uint8_t ext_idle_head;
+	uint8_t ext_idle_tail;
+	uint8_t ext_used;
+
+	/* save current play state */
+	memcpy(state, &sm->head.state, sizeof(state));
+	pressed = new MppPressed(sm->pressedKeys);
+	key_locked = sm->whatPlayKeyLocked;
+	noise = noiseRem;
+
+	/* save the key allocators, which the live keys keep using */
+	memcpy(ext_key, extKey, sizeof(ext_key));
+	memcpy(ext_hash, extHash, sizeof(ext_hash));
+	ext_idle_head = extIdleHead;
+	ext_idle_tail = extIdleTail;
+	ext_used = extUsed;
+	memcpy(mpe_chan, mpeChan, sizeof(mpe_chan));
+	mpe_seq = mpeSeq;
+
+	sm->pressedKeys.clear();
+	noiseRem = 1;
+	do_extended_reset();
+	memset(mpeChan, 0, sizeof(mpeChan));
+	mpeSeq = 0;
+
+	/* compute beat period like the BPM generator does */
+	period = dlg_bpm->bpm_get() / dlg_bpm->bpm_cur;
+	if (period == 0)
+		period = 1;
+	duty_ticks = ((period * dlg_bpm->duty) + ((2 * 100) - 1)) / (2 * 100);
+
+	vel = dlg_bpm->amp;
+	key = sm->baseKey;
+
+	renderActive = 1;
+	renderPosition = MPP_MIN_POS;
+
+	/* start at the first line */
+	sm->head.jumpPointer(TAILQ_FIRST(&sm->head.head));
+	sm->head.currLine(&start, &stop);
+	first = start;
+
+	/* each line can at most be visited a limited number of times */
+	max_beats = 8 * sm->head.getMaxLines();
+
+	for (n = 0; n != max_beats && first != 0; n++) {
+		sm->handleKeyPress(key, vel, 0);
+		sm->handleKeyRelease(key, vel, duty_ticks);
+
+		renderPosition += period;
+
+		/* stop when the song wraps around */
+		sm->head.currLine(&start, &stop);
+		if (start == first || start == 0)
+			break;
+	}
+
+	/* release all keys still pressed */
+	for (n = 0; n != sm->pressedKeys.count; n++) {
+		uint64_t temp = sm->pressedKeys.entry[n];
+
+		output_key(MPP_DEFAULT_TRACK(sm->unit), (temp >> 16) & 0xFF,
+		    (temp >> 32) & -1U, -vel, (temp >> 24) & 0xFF, 0);
+	}
+
+	renderActive = 0;
+
+	/* restore play state */
+	memcpy(&sm->head.state, state, sizeof(state));
+	sm->pressedKeys = *pressed;
+	delete pressed;
+	sm->whatPlayKeyLocked = key_locked;
+	noiseRem = noise;
+
+	memcpy(extKey, ext_key, sizeof(extKey));
+	memcpy(extHash, ext_hash, sizeof(extHash));
+	extIdleHead = ext_idle_head;
+	extIdleTail = ext_idle_tail;
+	extUsed = ext_used;
+	memcpy(mpeChan, mpe_chan, sizeof(mpeChan));
+	mpeSeq = mpe_seq;
+}
+
+void
+MppMainWindow :: handle_midi_file_render(int view)
+{
+	QFileDialog *diag;
+	struct umidi20_song *song_render;
+	pthread_mutex_t render_mtx;
+	uint8_t *data;
+	uint32_t len;
+	uint8_t status;
+	int n;
+
+	if (view < 0 || view >= MPP_MAX_VIEWS)
+		return;
+
+	diag = new QFileDialog(this, tr("Select MIDI File"),
+		Mpp.HomeDirMid,
+		QString("MIDI File (*.mid *.MID)"));
+
+	diag->setAcceptMode(QFileDialog::AcceptSave);
+	diag->setFileMode(QFileDialog::AnyFile);
+	diag->setDefaultSuffix(QString("mid"));
+
+	if (diag->exec() == 0) {
+		delete diag;
+		return;
+	}
+
+	Mpp.HomeDirMid = diag->directory().path();
+
+	/* make sure the scores are up to date */
+	handle_compile();
+
+	status = 1;
+
+	/* the detached song has its own mutex, see MppMidiSave */
+	umidi20_mutex_init(&render_mtx);
+	pthread_mutex_lock(&render_mtx);
+	song_render = umidi20_song_alloc(&render_mtx,
+	    UMIDI20_FILE_FORMAT_TYPE_0, 500, UMIDI20_FILE_DIVISION_TYPE_PPQ);
+
+	/* rendering redirects the output of all views */
+	atomic_lock_views();
+	atomic_lock();
+	if (song_render != 0) {
+		for (n = 0; n != MPP_MAX_TRACKS; n++) {
+			renderTrack[n] = umidi20_track_alloc();
+			if (renderTrack[n] == 0)
+				break;
+			umidi20_song_track_add(song_render, NULL, renderTrack[n], 0);
+		}
+		if (n == MPP_MAX_TRACKS) {
+			handle_midi_file_instr_prepend(renderTrack);
+			handle_render_locked(scores_main[view]);
+			status = 0;
+		}
+	}
+	memset(renderTrack, 0, sizeof(renderTrack));
+	atomic_unlock();
+	atomic_unlock_views();
+
+	/* encode without blocking playback and MIDI input */
+	if (song_render != 0) {
+		if (status == 0)
+			status = umidi20_save_file(song_render, &data, &len);
+		umidi20_song_free(song_render);
+	}
+	pthread_mutex_unlock(&render_mtx);
+	pthread_mutex_destroy(&render_mtx);
+
+	if (status == 0) {
+		QByteArray qdata = QByteArray::
+		    fromRawData((const char *)data, len);
+
+		status = MppWriteRawFile(diag->selectedFiles()[0], &qdata);
+
+		free(data);
+
+		if (status) {
+			QMessageBox box;
+
+			box.setText(tr("Could not write MIDI file!"));
+			box.setStandardButtons(QMessageBox::Ok);
+			box.setIcon(QMessageBox::Information);
+			box.setWindowIcon(QIcon(MppIconFile));
+			box.setWindowTitle(MppVersion);
+			box.exec();
+		}
+	} else {
+		QMessageBox box;
+
+		box.setText(tr("Could not render MIDI data!"));
+		box.setStandardButtons(QMessageBox::Ok);
+		box.setIcon(QMessageBox::Information);
+		box.setWindowIcon(QIcon(MppIconFile));
+		box.setWindowTitle(MppVersion);
+		box.exec();
+	}
+
+	delete diag;
+}
+
+void
+MppMainWindow :: handle_rewind()
+{
+	if (midiTriggered != 0) {
+		atomic_lock_views();
+		atomic_lock();
+		/* kill all leftover notes */
+		handle_stop();
+		/* send song stop event */
+		send_song_stop_locked();
+		atomic_unlock();
+		atomic_unlock_views();
+
+		/* wait for MIDI events to propagate */
+		MppSleep::msleep(100 /* ms */);
+	}
+
+	atomic_lock();
+
+	midiTriggered = 0;
+	midiPaused = 0;
+	pausePosition = 0;
+
+	update_play_device_no();
+
+	if (song != NULL) {
+		umidi20_song_stop(song,
+		    UMIDI20_FLAG_PLAY | UMIDI20_FLAG_RECORD);
+		umidi20_song_start(song, 0x40000000, 0x80000000,
+		    UMIDI20_FLAG_PLAY | UMIDI20_FLAG_RECORD);
+		startPosition = umidi20_get_curr_position() - 0x40000000;
+	}
+	atomic_unlock();
+}
+
+void
+MppMainWindow :: handle_midi_trigger()
+{
+	atomic_lock();
+
+	if (midiTriggered == 0) {
+		if (midiPlayOff == 0) {
+			umidi20_song_stop(song,
+			    UMIDI20_FLAG_PLAY | UMIDI20_FLAG_RECORD);
+			umidi20_song_start(song, pausePosition, 0x40000000,
+			    UMIDI20_FLAG_PLAY | UMIDI20_FLAG_RECORD);
+			startPosition = umidi20_get_curr_position() - pausePosition;
+		} else {
+			umidi20_song_stop(song,
+			    UMIDI20_FLAG_PLAY | UMIDI20_FLAG_RECORD);
+			umidi20_song_start(song, 0x40000000 + pausePosition, 0x80000000,
+			    UMIDI20_FLAG_PLAY | UMIDI20_FLAG_RECORD);
+			startPosition = umidi20_get_curr_position() - 0x40000000 - pausePosition;
+		}
+
+		/* cleanup old pending playback events */
+		for (unsigned x = 0; x != MPP_MAX_TRACKS; x++) {
+			struct umidi20_event *event;
+			struct umidi20_event *temp;
+
+			UMIDI20_QUEUE_FOREACH_SAFE(event, &track[x]->queue, temp) {
+				if (event->position >= 0x40000000) {
+					UMIDI20_IF_REMOVE(&track[x]->queue, event);
+					umidi20_event_free(event);
+				}
+			}
+		}
+
+		/* XXX first recursion point */
+		send_song_trigger_locked();
+
+		midiTriggered = 1;
+		midiPaused = 0;
+		pausePosition = 0;
+
+		dlg_bpm->handle_update(1);
+		tab_replay->metronome->handleUpdateLocked();
+		tab_loop->handle_timer_sync();
+	}
+	atomic_unlock();
+}
+
+void
+MppMainWindow :: handle_config_reload()
+{
+	struct umidi20_config cfg;
+	char *p_play;
+	char *p_rec;
 	int n;
 
 	/* setup the I/O devices */
@@ -1427,7 +1758,7 @@ MppMainWindow :: handle_config_reload()
 	/* wait for MIDI devices to be opened */
 	MppSleep::msleep(100 /* ms */);
 
-	/* apply local MIDI keys configuration */
+	/* apply local MIDI keys and MPE configuration */
 	handle_config_local_keys();
 }
 
@@ -1436,8 +1767,8 @@ MppMainWindow :: handle_config_apply()
 {
 	uint8_t deviceSelectionMap[MPP_MAX_DEVS];
 	uint32_t devInputMaskCopy[MPP_MAX_DEVS];
+	uint32_t deviceBitsCopy = 0;
 
-	deviceBits = 0;
 	memset(devInputMaskCopy, 0, sizeof(devInputMaskCopy));
 
 	for (uint8_t n = 0; n != MPP_MAX_DEVS; n++) {
@@ -1446,21 +1777,24 @@ MppMainWindow :: handle_config_apply()
 		deviceName[n] = MppQStringToAscii(led_config_dev[n]->text());
 
 		if (cbx_config_dev[n][0]->isChecked())
-			deviceBits |= (MPP_DEV0_PLAY << (2 * n));
+			deviceBitsCopy |= (MPP_DEV0_PLAY << (2 * n));
 
 		for (uint8_t x = 0; x != MPP_MAX_VIEWS; x++) {
 			if (cbx_config_dev[n][1 + x]->isChecked() == 0)
 				continue;
 			devInputMaskCopy[n] |= (1U << x);
-			deviceBits |= (MPP_DEV0_RECORD << (2 * n));
+			deviceBitsCopy |= (MPP_DEV0_RECORD << (2 * n));
 		}
 
 		deviceSelectionMap[n] = but_config_sel[n]->value();
 	}
 
 	atomic_lock();
+	deviceBits = deviceBitsCopy;
 	memcpy(devSelMap, deviceSelectionMap, sizeof(devSelMap));
 	memcpy(devInputMask, devInputMaskCopy, sizeof(devInputMask));
+	tx_route_update_locked();
+	rx_route_update_locked();
 	atomic_unlock();
 	
 	handle_config_reload();
@@ -1469,15 +1803,26 @@ MppMainWindow :: handle_config_apply()
 void
 MppMainWindow :: handle_config_local_keys()
 {
+	static const uint8_t mcm[] = {
+		0x65, 0x00, 0x64, 0x06,		/* RPN 6 */
+		0x06, MPP_MPE_CHANNELS,		/* lower zone members */
+		0x65, 0x7F, 0x64, 0x7F,		/* RPN null */
+	};
 	struct mid_data *d = &mid_data;
 	uint32_t pos;
 	uint32_t off = 0;
 	uint8_t midiTriggeredOld;
+	uint8_t mpe = 0;
 
 	atomic_lock();
 	midiTriggeredOld = midiTriggered;
 	midiTriggered = 1;
 
+	for (uint8_t x = 0; x != MPP_MAX_VIEWS; x++) {
+		if (scores_main[x]->noteMode == MM_NOTEMODE_MPE)
+			mpe = 1;
+	}
+
 	handle_midi_trigger();
 
 	/* compute relative time distance */
@@ -1513,6 +1858,20 @@ MppMainWindow :: handle_config_local_keys()
 				buf[2] = 0x00;
 				mid_add_raw(d, buf, 3, off++);
 			}
+
+			/*
+			 * Configure the MPE lower zone on the manager
+			 * channel. This also sets the pitch bend range
+			 * of the member channels to 48 semitones.
+			 */
+			if (mpe != 0 && x == 0) {
+				for (uint8_t y = 0; y != sizeof(mcm); y += 2) {
+					buf[0] = 0xB0;
+					buf[1] = mcm[y];
+					buf[2] = mcm[y + 1];
+					mid_add_raw(d, buf, 3, off++);
+				}
+			}
 		}
 	}
 
@@ -1580,7 +1939,7 @@ MppMainWindow :: check_play(uint8_t index, uint8_t chan, uint32_t off, uint8_t d
 	struct mid_data *d = &mid_data;
 	uint32_t pos;
 
-	if (index >= MPP_MAX_TRACKS || chan >= 0x10)
+	if (renderActive != 0 || index >= MPP_MAX_TRACKS || chan >= 0x10)
 		return (false);
 
 	handle_midi_trigger();
@@ -1609,16 +1968,32 @@ MppMainWindow :: check_record(uint8_t index, uint8_t chan, uint32_t off)
 	struct mid_data *d = &mid_data;
 	uint32_t pos;
 
-	if (midiRecordOff || index >= MPP_MAX_TRACKS || chan >= 0x10)
+	if (index >= MPP_MAX_TRACKS || chan >= 0x10)
 		return (false);
 
-	handle_midi_trigger();
+	if (renderActive != 0) {
+		/* offline rendering uses a virtual clock */
+		pos = (renderPosition + off) & 0x3FFFFFFFU;
+		d->track = renderTrack[index];
+	} else {
+		if (midiRecordOff)
+			return (false);
+
+		handle_midi_trigger();
+
+		if (midiJournal != NULL) {
+			/* long recordings go to disk */
+			pos = midiJournal->position(off);
+			d->track = midiJournal->track[index];
+		} else {
+			pos = (umidi20_get_curr_position() - startPosition + off) & 0x3FFFFFFFU;
+			d->track = track[index];
+		}
+	}
 
-	pos = (umidi20_get_curr_position() - startPosition + off) & 0x3FFFFFFFU;
 	if (pos < MPP_MIN_POS)
 		pos = MPP_MIN_POS;
 
-	d->track = track[index];
 	noteMode = scores_main[index / MPP_TRACKS_PER_VIEW]->noteMode;
 	mid_set_channel(d, chan);
 	mid_set_position(d, pos);
@@ -1627,58 +2002,171 @@ MppMainWindow :: check_record(uint8_t index, uint8_t chan, uint32_t off)
 	return (true);
 }
 
+static uint8_t
+MppExtHash(int key)
+{
+	return (((uint32_t)key * 0x9E3779B1U) >> 24) & (MPP_EXT_HASH - 1);
+}
+
+/* must be called locked */
+void
+MppMainWindow :: do_extended_reset(void)
+{
+	memset(extKey, 0, sizeof(extKey));
+	memset(extHash, 0, sizeof(extHash));
+	extIdleHead = 0;
+	extIdleTail = 0;
+	extUsed = 0;
+}
+
+/* must be called locked */
+void
+MppMainWindow :: do_extended_idle_remove(uint8_t n)
+{
+	struct MppExtKey *pk = &extKey[n - 1];
+
+	if (pk->iprev != 0)
+		extKey[pk->iprev - 1].inext = pk->inext;
+	else
+		extIdleHead = pk->inext;
+	if (pk->inext != 0)
+		extKey[pk->inext - 1].iprev = pk->iprev;
+	else
+		extIdleTail = pk->iprev;
+	pk->iprev = 0;
+	pk->inext = 0;
+}
+
+/* must be called locked */
 int
 MppMainWindow :: do_extended_alloc(int key, int refcount)
 {
+	struct MppExtKey *pk;
+	uint8_t *pn;
+	uint8_t h;
+	uint8_t n;
+
 	key++;	/* avoid zero default */
 
+	h = MppExtHash(key);
+
 	/* use existing key, if possible */
-	for (int x = 0; x != 128; x++) {
-		if (extended_keys[x][0] == key) {
-			extended_keys[x][1] += refcount;
-			if (extended_keys[x][1] < 0) {
+	for (n = extHash[h]; n != 0; n = pk->hnext) {
+		pk = &extKey[n - 1];
+		if (pk->key != key)
+			continue;
+		if (pk->refcount + refcount < 0) {
+			/* already released */
+			return (-1);
+		}
+		if (pk->refcount == 0 && refcount > 0)
+			do_extended_idle_remove(n);
+		pk->refcount += refcount;
+		if (pk->refcount == 0 && refcount < 0) {
+			/* keep the key mapped until evicted */
+			pk->iprev = extIdleTail;
+			if (extIdleTail != 0)
+				extKey[extIdleTail - 1].inext = n;
+			else
+				extIdleHead = n;
+			extIdleTail = n;
+		}
+		return (n - 1);
+	}
+
+	if (refcount <= 0)
+		return (-1);
+
+	if (extUsed != MPP_EXT_KEYS) {
+		/* use a slot which was never used */
+		n = ++extUsed;
+	} else if (extIdleHead != 0) {
+		/* evict the least recently released key */
+		n = extIdleHead;
+		do_extended_idle_remove(n);
+
+		pk = &extKey[n - 1];
+		for (pn = &extHash[MppExtHash(pk->key)]; *pn != n;
+		    pn = &extKey[*pn - 1].hnext)
+			;
+		*pn = pk->hnext;
+
+		__atomic_fetch_add(&extEvictions, 1, __ATOMIC_RELAXED);
+	} else {
+		/* all slots are pressed */
+		__atomic_fetch_add(&extOverflows, 1, __ATOMIC_RELAXED);
+		return (-1);
+	}
+
+	pk = &extKey[n - 1];
+	pk->key = key;
+	pk->refcount = refcount;
+	pk->hnext = extHash[h];
+	extHash[h] = n;
+
+	return (n - 1);
+}
+
+/*
+ * Returns the MPE member channel of a key, 1 to 15, or -1 if no
+ * channel is available. Channel 0 is the manager channel. Must be
+ * called locked.
+ */
+int
+MppMainWindow :: do_mpe_alloc(int key, int refcount)
+{
+	struct MppMpeChan *pc;
+	struct MppMpeChan *pf;
+	uint32_t now;
+
+	key++;	/* avoid zero default */
+
+	now = renderActive ? renderPosition : umidi20_get_curr_position();
+
+	/* use existing key, if possible */
+	pf = NULL;
+	for (pc = mpeChan; pc != mpeChan + MPP_MPE_CHANNELS; pc++) {
+		if (pc->key == key) {
+			if (pc->refcount + refcount < 0) {
 				/* already released */
-				extended_keys[x][1] -= refcount;
 				return (-1);
-			} else {
-				return (x);
 			}
+			pc->refcount += refcount;
+			if (pc->refcount == 0 && refcount < 0)
+				pc->released = ++mpeSeq;
+			return (1 + (pc - mpeChan));
 		}
+		if (pc->refcount != 0)
+			continue;
+		/* skip channels having a note with a duration sounding */
+		if ((int32_t)(pc->ends - now) > 0)
+			continue;
+		if (pf == NULL || (int32_t)(pc->released - pf->released) < 0)
+			pf = pc;
 	}
 
-	if (refcount > 0) {
-		/* try to allocate an empty key */
-		for (int x = 0; x != 128; x++) {
-			if (extended_keys[x][0] != 0)
-				continue;
-			extended_keys[x][0] = key;
-			extended_keys[x][1] = refcount;
-			return (x);
-		}
-		/* release all unused keys, shouldn't happen */
-		for (int x = 0; x != 128; x++) {
-			if (extended_keys[x][1] != 0)
-				continue;
-			extended_keys[x][0] = 0;
-			extended_keys[x][1] = 0;
-		}
-		/* try to allocate an empty key */
-		for (int x = 0; x != 128; x++) {
-			if (extended_keys[x][0] != 0)
-				continue;
-			extended_keys[x][0] = key;
-			extended_keys[x][1] = refcount;
-			return (x);
-		}
+	if (refcount <= 0)
+		return (-1);
+
+	if (pf == NULL) {
+		/* all channels are pressed */
+		__atomic_fetch_add(&mpeOverflows, 1, __ATOMIC_RELAXED);
+		return (-1);
 	}
-	return (-1);
+
+	pf->key = key;
+	pf->refcount = refcount;
+
+	return (1 + (pf - mpeChan));
 }
 
 void
-MppMainWindow :: do_key_press(int key, int vel, int dur)
+MppMainWindow :: do_key_press(int key, int vel, int dur, int delay)
 {
 	struct mid_data *d = &mid_data;
+	int64_t bend;
 	int index;
+	int chan;
 
 	/* range check(s) */
 	if (vel > 127)
@@ -1700,6 +2188,33 @@ MppMainWindow :: do_key_press(int key, int vel, int dur)
 			return;
 		mid_extended_key_press(d, index, key, vel, dur);
 		break;
+	case MM_NOTEMODE_MPE:
+		index = (key + MPP_BAND_STEP_24) / MPP_BAND_STEP_12;
+		/* range check(s) */
+		if (index > 127 || index < 0)
+			return;
+		chan = do_mpe_alloc(key, (vel <= 0) ? -1 : 1);
+		if (chan < 0)
+			return;
+		mid_set_channel(d, chan);
+		if (vel > 0) {
+			/* the fine offset is sent as pitch bend before the key */
+			bend = (int64_t)(key - index * MPP_BAND_STEP_12) * 8192;
+			bend /= MPP_MPE_BEND_RANGE * MPP_BAND_STEP_12;
+			mid_pitch_bend(d, 8192 + bend);
+		}
+		mid_key_press(d, index, vel, dur);
+
+		/*
+		 * Keys having a duration are released automatically.
+		 * The channel is not reused until the note has ended.
+		 */
+		if (vel > 0 && dur > 0) {
+			mpeChan[chan - 1].ends = dur + delay +
+			    (renderActive ? renderPosition : umidi20_get_curr_position());
+			do_mpe_alloc(key, -1);
+		}
+		break;
 	default:
 		key = (key + MPP_BAND_STEP_24) / MPP_BAND_STEP_12;
 		/* range check(s) */
@@ -1715,6 +2230,7 @@ MppMainWindow :: do_key_pressure(int key, int pressure)
 {
 	struct mid_data *d = &mid_data;
 	uint8_t buf[4];
+	int chan;
 
 	if (pressure > 127)
 		pressure = 127;
@@ -1731,6 +2247,18 @@ MppMainWindow :: do_key_pressure(int key, int pressure)
 		if (key < 0)
 			return;
 		break;
+	case MM_NOTEMODE_MPE:
+		chan = do_mpe_alloc(key, 0);
+		if (chan < 0)
+			return;
+
+		/* MPE uses channel pressure on the member channel */
+		buf[0] = 0xD0 | chan;
+		buf[1] = pressure & 0x7F;
+
+		mid_set_channel(d, chan);
+		mid_add_raw(d, buf, 2, 0);
+		return;
 	default:
 		key = (key + MPP_BAND_STEP_24) / MPP_BAND_STEP_12;
 		if (key >= 128 || key < 0)
@@ -1753,6 +2281,7 @@ MppMainWindow :: handle_stop(int flag)
 	uint8_t ScMidiTriggered;
 	uint8_t ScMidiRecordOff;
 	int out_key;
+	uint32_t n;
 	uint8_t chan;
 	uint8_t x;
 	uint8_t z;
@@ -1767,24 +2296,21 @@ MppMainWindow :: handle_stop(int flag)
 
 	    /* TRANS mode cleanup */
 
-	    for (x = 0; x != MPP_PRESSED_MAX; x++) {
-
-		pkey = &scores_main[z]->pressedKeys[x];
-
-		if (*pkey != 0) {
+	    for (n = 0; n != scores_main[z]->pressedKeys.count; n++) {
 
-			out_key = (*pkey >> 32) & -1U;
-			chan = (*pkey >> 16) & 0xFF;
-			delay = (*pkey >> 24) & 0xFF;
+		pkey = &scores_main[z]->pressedKeys.entry[n];
 
-			/* only release once */
-			*pkey = 0;
+		out_key = (*pkey >> 32) & -1U;
+		chan = (*pkey >> 16) & 0xFF;
+		delay = (*pkey >> 24) & 0xFF;
 
-			output_key(MPP_DEFAULT_TRACK(z),
-			    chan, out_key, 0, delay, 0);
-		}
+		output_key(MPP_DEFAULT_TRACK(z),
+		    chan, out_key, 0, delay, 0);
 	    }
 
+	    /* only release once */
+	    scores_main[z]->pressedKeys.clear();
+
 	    /* CHORD mode cleanup */
 
 	    for (x = 0; x != MPP_MAX_CHORD_MAP; x++) {
@@ -1806,9 +2332,6 @@ MppMainWindow :: handle_stop(int flag)
 			output_key(ps->trackSec, ps->channelSec, ps->key, 0, 0, 0);
 	    }
 
-	    /* SYSEX mode cleanup */
-	    memset(extended_keys, 0, sizeof(extended_keys));
-
 	    /* check if we should kill the pedal, modulation and pitch */
 	    if (!(flag & 1)) {
 		scores_main[z]->outputControl(0x40, 0);
@@ -1817,22 +2340,29 @@ MppMainWindow :: handle_stop(int flag)
 	    }
 	}
 
+	/* SYSEX mode cleanup, after all views released their keys */
+	do_extended_reset();
+
+	/* MPE mode cleanup */
+	memset(mpeChan, 0, sizeof(mpeChan));
+	mpeSeq = 0;
+
 	midiTriggered = ScMidiTriggered;
 	midiRecordOff = ScMidiRecordOff;
 }
 
-uint32_t
-MppMainWindow :: get_time_offset(void)
+static uint32_t
+MppTimeOffset(const struct MppTimeState *pts)
 {
 	uint32_t time_offset;
 
-	if (midiTriggered == 0) {
-		if (midiPaused != 0)
-			time_offset = pausePosition;
+	if (pts->midiTriggered == 0) {
+		if (pts->midiPaused != 0)
+			time_offset = pts->pausePosition;
 		else
 			time_offset = 0;
 	} else {
-		time_offset = (umidi20_get_curr_position() - startPosition) & 0x3FFFFFFFU;
+		time_offset = (umidi20_get_curr_position() - pts->startPosition) & 0x3FFFFFFFU;
 	}
 
 	time_offset %= 100000000UL;
@@ -1840,28 +2370,206 @@ MppMainWindow :: get_time_offset(void)
 	return (time_offset);
 }
 
+/* must be called locked */
+uint32_t
+MppMainWindow :: get_time_offset(void)
+{
+	struct MppTimeState ts;
+
+	ts.startPosition = startPosition;
+	ts.pausePosition = pausePosition;
+	ts.midiTriggered = midiTriggered;
+	ts.midiPaused = midiPaused;
+
+	return (MppTimeOffset(&ts));
+}
+
+/* can be called unlocked */
+uint32_t
+MppMainWindow :: get_time_offset_snapshot(void)
+{
+	struct MppTimeState ts;
+
+	MppSeqRead(&timeStateSeq, &ts, &timeState, sizeof(ts));
+
+	return (MppTimeOffset(&ts));
+}
+
+/* must be called locked */
+void
+MppMainWindow :: publish_play_state_locked(void)
+{
+	struct MppTimeState ts;
+
+	memset(&ts, 0, sizeof(ts));
+
+	ts.startPosition = startPosition;
+	ts.pausePosition = pausePosition;
+	ts.midiTriggered = midiTriggered;
+	ts.midiPaused = midiPaused;
+
+	MppSeqWrite(&timeStateSeq, &timeState, &ts, sizeof(ts));
+}
+
+/*
+ * Must be called locked. Must be called after changing any device
+ * selection, mute, instrument mute or track volume setting.
+ */
+void
+MppMainWindow :: tx_route_update_locked(void)
+{
+	uint32_t pass[MPP_TX_CLASS_MAX][16];
+	uint32_t select;
+	uint32_t mask;
+	int devno;
+	int x;
+
+	memset(pass, 0, sizeof(pass));
+
+	/* compute which devices pass which events */
+	for (x = 0; x != MPP_MAX_DEVS; x++) {
+		for (uint8_t chan = 0; chan != 16; chan++) {
+			if (instr[chan].muted || muteMap[x][chan])
+				continue;
+			pass[MPP_TX_CLASS_CHANNEL][chan] |= (1U << x);
+			if (mutePedal[x] == 0)
+				pass[MPP_TX_CLASS_PEDAL][chan] |= (1U << x);
+			if (muteAllControl[x] == 0)
+				pass[MPP_TX_CLASS_CONTROL][chan] |= (1U << x);
+			if (muteProgram[x] == 0)
+				pass[MPP_TX_CLASS_PROGRAM][chan] |= (1U << x);
+		}
+		if (muteAllNonChannel[x] == 0)
+			pass[MPP_TX_CLASS_SYSTEM][0] |= (1U << x);
+	}
+
+	/* real devices only pass or drop their own events */
+	for (x = 0; x != MPP_MAX_DEVS; x++) {
+		for (uint8_t cls = 0; cls != MPP_TX_CLASS_MAX; cls++) {
+			for (uint8_t chan = 0; chan != 16; chan++) {
+				mask = pass[cls][chan] & (1U << x);
+				__atomic_store_n(&txRoute[x][cls][chan],
+				    MPP_TX_ROUTE(mask, MPP_VOLUME_UNIT),
+				    __ATOMIC_RELAXED);
+			}
+		}
+	}
+
+	/* view tracks are duplicated to the selected devices */
+	for (x = 0; x != MPP_MAX_TRACKS; x++) {
+		MppScoreMain *sm = scores_main[x / MPP_TRACKS_PER_VIEW];
+
+		switch (x % MPP_TRACKS_PER_VIEW) {
+		case MPP_DEFAULT_TRACK(0):
+			devno = sm->synthDevice;
+			break;
+		case MPP_TREBLE_TRACK(0):
+			devno = sm->synthDeviceTreb;
+			break;
+		case MPP_BASS_TRACK(0):
+			devno = sm->synthDeviceBase;
+			break;
+		default:
+			devno = -2;	/* no device */
+			break;
+		}
+
+		select = 0;
+		for (int y = 0; y != MPP_MAX_DEVS; y++) {
+			if (devno != -1 && devSelMap[y] != devno)
+				continue;
+			if (((deviceBits >> (2 * y)) & MPP_DEV0_PLAY) == 0)
+				continue;
+			select |= (1U << y);
+		}
+
+		for (uint8_t cls = 0; cls != MPP_TX_CLASS_MAX; cls++) {
+			for (uint8_t chan = 0; chan != 16; chan++) {
+				mask = pass[cls][chan] & select;
+				__atomic_store_n(&txRoute[MPP_MAX_DEVS + x][cls][chan],
+				    MPP_TX_ROUTE(mask, trackVolume[x]),
+				    __ATOMIC_RELAXED);
+			}
+		}
+	}
+}
+
 void
 MppMainWindow :: do_clock_stats(void)
 {
 	uint32_t time_offset;
 	char buf[32];
 
-	atomic_lock();
-	time_offset = get_time_offset();
-	atomic_unlock();
+	time_offset = get_time_offset_snapshot();
 
 	snprintf(buf, sizeof(buf), "%u.%03u", time_offset / 1000, time_offset % 1000);
 
 	lbl_curr_time_val->display(QString(buf));
 }
 
-/* NOTE: Is called unlocked */
+/* must be called locked */
+void
+MppMainWindow :: rx_route_update_locked(void)
+{
+	MppScoreMain *sm;
+	uint8_t x;
+	uint8_t y;
+	uint8_t n;
+
+	memset(rxRoute, 0, sizeof(rxRoute));
+
+	for (n = 0; n != MPP_MAX_VIEWS; n++) {
+		sm = scores_main[n];
+
+		for (x = 0; x != MPP_MAX_DEVS; x++) {
+			/* filter on device, if any */
+			if (!(devInputMask[x] & (1U << n)))
+				continue;
+
+			/* filter on channel, if any */
+			for (y = 0; y != 16; y++) {
+				if (sm->inputChannel > -1 &&
+				    (uint8_t)sm->inputChannel != y)
+					continue;
+				rxRoute[x][y] |= (1U << n);
+			}
+			rxRoute[x][16] |= (1U << n);
+		}
+	}
+}
+
+/* must be called locked */
+static uint32_t
+MidiEventRxViews(MppMainWindow *mw, uint8_t device_no, struct umidi20_event *event)
+{
+	uint32_t what = umidi20_event_get_what(event);
+
+	if (device_no >= MPP_MAX_DEVS)
+		return (0);
+	else if (what & UMIDI20_WHAT_CHANNEL)
+		return (mw->rxRoute[device_no][umidi20_event_get_channel(event) & 0xF]);
+	else
+		return (mw->rxRoute[device_no][16]);
+}
+
+/*
+ * NOTE: Is called unlocked. The views receiving the event are
+ * dispatched with only their view lock held, so that a heavy
+ * operation on one view does not delay key events on another
+ * view. The main lock is only taken for shared state, like the
+ * shortcuts, the instruments and the output tracks. Jump shortcuts
+ * affect all views.
+ */
 static void
 MidiEventRxCallback(uint8_t device_no, void *arg, struct umidi20_event *event, uint8_t *drop)
 {
 	MppMainWindow *mw = (MppMainWindow *)arg;
 	MppScoreMain *sm;
+	uint64_t start;
 	uint32_t what;
+	uint32_t views;
+	uint32_t mask;
+	uint8_t handled;
 	uint8_t chan;
 	uint8_t ctrl;
 	int key;
@@ -1870,6 +2578,8 @@ MidiEventRxCallback(uint8_t device_no, void *arg, struct umidi20_event *event, u
 
 	*drop = 1;
 
+	start = MppLatency::now();
+
 	mw->atomic_lock();
 
 	what = umidi20_event_get_what(event);
@@ -1877,13 +2587,9 @@ MidiEventRxCallback(uint8_t device_no, void *arg, struct umidi20_event *event, u
 	if (what & UMIDI20_WHAT_CHANNEL) {
 		if (mw->controlRecordOn != 0 &&
 		    umidi20_event_is_key_end(event) == 0) {
-			if (mw->numControlEvents < MPP_MAX_QUEUE) {
-				mw->controlEvents[mw->numControlEvents][0] = event->cmd[0];
-				mw->controlEvents[mw->numControlEvents][1] = event->cmd[1];
-				mw->controlEvents[mw->numControlEvents][2] = event->cmd[2];
-				mw->controlEvents[mw->numControlEvents][3] = event->cmd[3];
-				mw->numControlEvents++;
-			}
+			mw->controlEvents->push(event->cmd[0] |
+			    (event->cmd[1] << 8) | (event->cmd[2] << 16) |
+			    ((uint32_t)event->cmd[3] << 24));
 		}
 	}
 	if (umidi20_event_is_key_start(event)) {
@@ -1891,40 +2597,65 @@ MidiEventRxCallback(uint8_t device_no, void *arg, struct umidi20_event *event, u
 		key = (umidi20_event_get_key(event) & 0x7F) * MPP_BAND_STEP_12;
 		vel = umidi20_event_get_velocity(event);
 
+		mw->latency->rxEvent();
+
 		switch (mw->scoreRecordOn) {
 		case 1:
 		case 2:
-			if (mw->numInputEvents < MPP_MAX_QUEUE) {
-				mw->inputEvents[mw->numInputEvents] = key / MPP_BAND_STEP_12;
-				mw->numInputEvents++;
-				mw->lastInputEvent = umidi20_get_curr_position();
-			}
+			mw->scoreRec->add(umidi20_get_curr_position(),
+			    key / MPP_BAND_STEP_12, 1);
 			break;
 		default:
 			break;
 		}
+	} else if (umidi20_event_is_key_end(event)) {
+		if (mw->scoreRecordOn != 0) {
+			mw->scoreRec->add(umidi20_get_curr_position(),
+			    umidi20_event_get_key(event), 0);
+		}
 	}
 
+	views = MidiEventRxViews(mw, device_no, event);
+	if (views != 0 && mw->controlRecordOn == 0 &&
+	    mw->tab_shortcut->is_jump_event_locked(event) != 0)
+		views = (1U << MPP_MAX_VIEWS) - 1;
+	mw->atomic_unlock();
+
+	if (views == 0)
+		goto done;
+
+	/* lock views in ascending order */
 	for (n = 0; n != MPP_MAX_VIEWS; n++) {
-		sm = mw->scores_main[n];
+		if (views & (1U << n))
+			mw->scores_main[n]->atomicLock();
+	}
 
-		/* filter on device, if any */
-		if (!(mw->devInputMask[device_no] & (1U << n)))
+	/* the settings might have changed meanwhile */
+	mw->atomic_lock();
+	mask = MidiEventRxViews(mw, device_no, event) & views;
+	mw->atomic_unlock();
+
+	for (n = 0; n != MPP_MAX_VIEWS; n++) {
+		if (!(mask & (1U << n)))
 			continue;
 
-		/* filter on channel, if any */
-		if ((what & UMIDI20_WHAT_CHANNEL) && (sm->inputChannel > -1)) {
-			if ((uint8_t)sm->inputChannel != umidi20_event_get_channel(event))
-					continue;
-		}
+		sm = mw->scores_main[n];
 
 		chan = sm->synthChannel;
 
 		ctrl = umidi20_event_get_control_address(event);
 
-		if (mw->controlRecordOn == 0 &&
-		    mw->tab_shortcut->handle_event_received_locked(sm, event) != 0) {
-			/* command event */
+		mw->atomic_lock();
+		handled = (mw->controlRecordOn == 0 &&
+		    mw->tab_shortcut->handle_event_received_locked(sm,
+		    event, views) != 0);
+		if (handled == 0 && (what & (UMIDI20_WHAT_CONTROL_VALUE |
+		    UMIDI20_WHAT_PROGRAM_VALUE)))
+			handled = mw->do_instr_check(event, &chan);
+		mw->atomic_unlock();
+
+		if (handled != 0) {
+			/* command or instrument event */
 		} else if (umidi20_event_is_pitch_bend(event)) {
 
 			vel = umidi20_event_get_pitch_value(event);
@@ -1979,8 +2710,6 @@ MidiEventRxCallback(uint8_t device_no, void *arg, struct umidi20_event *event, u
 
 			sm->handleMidiKeyReleaseLocked(key, vel);
 
-		} else if (mw->do_instr_check(event, &chan)) {
-
 		} else if ((what & UMIDI20_WHAT_CONTROL_VALUE) &&
 		    (ctrl < 120)) {
 
@@ -1991,171 +2720,296 @@ MidiEventRxCallback(uint8_t device_no, void *arg, struct umidi20_event *event, u
 			sm->outputControl(ctrl, vel);
 		}
 	}
-	mw->atomic_unlock();
+
+	for (n = MPP_MAX_VIEWS; n-- != 0; ) {
+		if (views & (1U << n))
+			mw->scores_main[n]->atomicUnlock();
+	}
+done:
+	mw->latency->record(MPP_LATENCY_RX_HANDLER, MppLatency::now() - start);
+}
+
+static uint8_t
+MidiEventTxClass(uint32_t what, struct umidi20_event *event)
+{
+	if (!(what & UMIDI20_WHAT_CHANNEL))
+		return (MPP_TX_CLASS_SYSTEM);
+	if (what & UMIDI20_WHAT_CONTROL_VALUE) {
+		if (umidi20_event_get_control_address(event) == 0x40)
+			return (MPP_TX_CLASS_PEDAL);
+		else
+			return (MPP_TX_CLASS_CONTROL);
+	}
+	if (what & UMIDI20_WHAT_PROGRAM_VALUE)
+		return (MPP_TX_CLASS_PROGRAM);
+	return (MPP_TX_CLASS_CHANNEL);
+}
+
+/*
+ * Returns the coalescing slot of a channel event, or -1 if the
+ * event must be transmitted in order. Bank select, data entry,
+ * the LSB of 14-bit controls, pedals, (N)RPN and channel mode
+ * messages are never coalesced.
+ */
+static int
+MidiEventTxSlot(uint32_t what, struct umidi20_event *event)
+{
+	uint8_t addr;
+
+	if (what & UMIDI20_WHAT_CONTROL_VALUE) {
+		addr = umidi20_event_get_control_address(event);
+		if (addr == 0x00 || addr == 0x06 ||
+		    (addr >= 0x20 && addr <= 0x45) ||
+		    (addr >= 0x60 && addr <= 0x65) || addr >= 0x78)
+			return (-1);
+		return (addr);
+	}
+	if (umidi20_event_is_pitch_bend(event))
+		return (MPP_TX_SLOT_PITCH);
+	if (what & UMIDI20_WHAT_CHANNEL_PRESSURE)
+		return (MPP_TX_SLOT_PRESSURE);
+	return (-1);
 }
 
-/* NOTE: Is called unlocked */
+/*
+ * Returns non-zero if the delayed event of a slot is still queued
+ * at or after the given position. The bound protects against
+ * delayed events which were drained from the queue without being
+ * sent.
+ */
+static int
+MidiEventTxQueued(struct MppTxCoalesce *pc, uint8_t chan, int slot,
+    uint32_t position)
+{
+	uint32_t bit = 1U << (slot % 32);
+	uint32_t delta;
+
+	if (((pc->busy[chan][slot / 32] | pc->drop[chan][slot / 32]) & bit) == 0)
+		return (0);
+	delta = pc->last[chan][slot] - position;
+	return (delta <= MPP_TX_WINDOW_MAX);
+}
+
+/*
+ * Is called when an event reaches a real device. A delayed event
+ * gets the latest value of its slot, or is dropped if its value
+ * was already flushed. Returns non-zero if the event should be
+ * dropped.
+ */
+static int
+MidiEventTxDelayed(struct MppTxCoalesce *pc, uint8_t chan, int slot,
+    struct umidi20_event *event)
+{
+	uint32_t bit = 1U << (slot % 32);
+
+	if (((pc->busy[chan][slot / 32] | pc->drop[chan][slot / 32]) & bit) == 0 ||
+	    event->position != pc->last[chan][slot])
+		return (0);
+
+	pc->busy[chan][slot / 32] &= ~bit;
+
+	if (pc->drop[chan][slot / 32] & bit) {
+		pc->drop[chan][slot / 32] &= ~bit;
+		return (1);
+	}
+	memcpy(event->cmd, pc->value[chan][slot], sizeof(pc->value[chan][slot]));
+	return (0);
+}
+
+/*
+ * Send the latest value of all delayed events of a channel at the
+ * given position, so that they are transmitted before the event
+ * being queued next. The delayed events are dropped when they
+ * reach the device.
+ */
+static void
+MidiEventTxFlush(MppMainWindow *mw, struct MppTxCoalesce *pc,
+    struct umidi20_event *event, uint8_t x, uint8_t chan, uint32_t position)
+{
+	struct umidi20_event *p_event;
+	uint32_t busy;
+	uint32_t bit;
+	int slot;
+
+	for (unsigned w = 0; w != MPP_TX_SLOT_WORDS; w++) {
+		for (busy = pc->busy[chan][w]; busy != 0; busy &= busy - 1) {
+			slot = (w * 32) + __builtin_ctz(busy);
+			/* a delayed event at this position is sent first */
+			if (pc->last[chan][slot] == position ||
+			    MidiEventTxQueued(pc, chan, slot, position) == 0)
+				continue;
+			p_event = umidi20_event_copy(event, 1);
+			if (p_event == NULL)
+				continue;
+			memcpy(p_event->cmd, pc->value[chan][slot],
+			    sizeof(pc->value[chan][slot]));
+			p_event->device_no = x;
+			p_event->position = position;
+			umidi20_event_queue_insert(&root_dev.play[x].queue,
+			    p_event, UMIDI20_CACHE_INPUT);
+
+			bit = 1U << (slot % 32);
+			pc->busy[chan][w] &= ~bit;
+			pc->drop[chan][w] |= bit;
+			__atomic_fetch_add(&mw->txFlushed, 1, __ATOMIC_RELAXED);
+		}
+	}
+}
+
+/*
+ * NOTE: Is called with the libumidi20 root device mutex held. No
+ * locks are taken from here. All routing decisions are a single
+ * lookup in the TX routing table.
+ */
 static void
 MidiEventTxCallback(uint8_t device_no, void *arg, struct umidi20_event *event, uint8_t *drop)
 {
 	MppMainWindow *mw = (MppMainWindow *)arg;
 	struct umidi20_event *p_event;
 	uint32_t what;
-	int do_drop = 0;
-
-	mw->atomic_lock();
+	uint32_t route;
+	uint32_t mask;
+	uint32_t count;
+	uint32_t chain;
+	uint32_t window;
+	uint32_t bit = 0;
+	uint8_t source;
+	uint8_t chan;
+	uint8_t cls;
+	int slot;
+	int vel;
 
 	what = umidi20_event_get_what(event);
 
-	if (what & UMIDI20_WHAT_CHANNEL) {
-		uint8_t chan = umidi20_event_get_channel(event) & 0xF;
-		int vel = umidi20_event_get_velocity(event);
-
-		if (mw->instr[chan].muted) {
-			do_drop = 1;
-		} else if (device_no < MPP_MAX_DEVS) {
-			/* check for pedal and control events mute */
-			if (what & UMIDI20_WHAT_CONTROL_VALUE) {
-				if (umidi20_event_get_control_address(event) == 0x40) {
-					if (mw->mutePedal[device_no])
-						do_drop = 1;
-				} else {
-					if (mw->muteAllControl[device_no])
-						do_drop = 1;
-				}
-			}
-			/* check for program mute */
-			if (what & UMIDI20_WHAT_PROGRAM_VALUE) {
-			  	if (mw->muteProgram[device_no])
-					do_drop = 1;
-			}
-			/* check for channel mute */
-			if (mw->muteMap[device_no][chan]) {
-				do_drop = 1;
-			}
-		} else if (device_no >= MPP_MAGIC_DEVNO &&
-		    device_no < UMIDI20_N_DEVICES) {
-			int index = device_no - MPP_MAGIC_DEVNO;
-			int devno = -2;	/* no device */
+	/* meta events are only passed to real devices */
+	if ((what & UMIDI20_WHAT_CHANNEL) == 0 && event->cmd[1] == 0xFF) {
+		*drop = (device_no >= MPP_MAGIC_DEVNO);
+		return;
+	}
 
-			if (vel != 0) {
-				/* adjust volume, if any */
-				vel = (vel * mw->trackVolume[index]) / MPP_VOLUME_UNIT;
+	if (device_no < MPP_MAX_DEVS) {
+		source = device_no;
+	} else if (device_no >= MPP_MAGIC_DEVNO &&
+	    device_no < UMIDI20_N_DEVICES) {
+		source = MPP_MAX_DEVS + (device_no - MPP_MAGIC_DEVNO);
+	} else {
+		*drop = 1;
+		return;
+	}
 
-				if (vel > 127)
-					vel = 127;
-				else if (vel < 1)
-					vel = 1;
+	cls = MidiEventTxClass(what, event);
+	chan = (cls == MPP_TX_CLASS_SYSTEM) ? 0 :
+	    (umidi20_event_get_channel(event) & 0xF);
 
-				umidi20_event_set_velocity(event, vel);
-			}
+	route = __atomic_load_n(&mw->txRoute[source][cls][chan], __ATOMIC_RELAXED);
+	mask = MPP_TX_ROUTE_MASK(route);
 
-			/* check if we should duplicate events for other devices */
-			MppScoreMain *sm = mw->scores_main[index / MPP_TRACKS_PER_VIEW];
+	slot = (cls == MPP_TX_CLASS_SYSTEM) ? -1 : MidiEventTxSlot(what, event);
 
-			switch (index % MPP_TRACKS_PER_VIEW) {
-			case MPP_DEFAULT_TRACK(0):
-				devno = sm->synthDevice;
-				break;
-			case MPP_TREBLE_TRACK(0):
-				devno = sm->synthDeviceTreb;
-				break;
-			case MPP_BASS_TRACK(0):
-				devno = sm->synthDeviceBase;
-				break;
-			default:
-				break;
-			}
+	/* real devices only check if the event is muted or delayed */
+	if (source < MPP_MAX_DEVS) {
+		*drop = (mask == 0);
+		if (slot > -1 &&
+		    MidiEventTxDelayed(&mw->txCoalesce[source], chan, slot, event))
+			*drop = 1;
+		return;
+	}
 
-			for (int x = 0; x != MPP_MAX_DEVS; x++) {
-				if (devno != -1 && mw->devSelMap[x] != devno)
-					continue;
-				if (((mw->deviceBits >> (2 * x)) & MPP_DEV0_PLAY) == 0)
-					continue;
-				/* check for pedal and control events mute */
-				if (what & UMIDI20_WHAT_CONTROL_VALUE) {
-					if (umidi20_event_get_control_address(event) == 0x40) {
-						if (mw->mutePedal[x])
-							continue;
-					} else {
-						if (mw->muteAllControl[x])
-							continue;
-					}
-				}
+	if (mask != 0 && cls != MPP_TX_CLASS_SYSTEM) {
+		vel = umidi20_event_get_velocity(event);
 
-				/* check for program mute */
-				if (what & UMIDI20_WHAT_PROGRAM_VALUE) {
-					if (mw->muteProgram[x])
-						continue;
-				}
+		if (vel != 0) {
+			/* measure RX to TX delay, if any */
+			if (umidi20_event_is_key_start(event))
+				mw->latency->txEvent();
 
-				/* check for channel mute */
-				if (mw->muteMap[x][chan])
-					continue;
+			/* adjust volume, if any */
+			vel = (vel * MPP_TX_ROUTE_VOLUME(route)) / MPP_VOLUME_UNIT;
 
-				/* duplicate event */
-				p_event = umidi20_event_copy(event, 1);
-				if (p_event != NULL) {
-					p_event->device_no = x;
-					umidi20_event_queue_insert(&root_dev.play[x].queue,
-					    p_event, UMIDI20_CACHE_INPUT);
-				}
-			}
-			do_drop = 1;
-		} else {
-			do_drop = 1;
+			if (vel > 127)
+				vel = 127;
+			else if (vel < 1)
+				vel = 1;
+
+			umidi20_event_set_velocity(event, vel);
 		}
-	} else if (event->cmd[1] != 0xFF) {
-		if (device_no < MPP_MAX_DEVS) {
-			if (mw->muteAllNonChannel[device_no])
-				do_drop = 1;
-		} else if (device_no >= MPP_MAGIC_DEVNO &&
-		    device_no < UMIDI20_N_DEVICES) {
-			int index = device_no - MPP_MAGIC_DEVNO;
-			int devno = -2;	/* no device */
-
-			/* check if we should duplicate events for other devices */
-			MppScoreMain *sm = mw->scores_main[index / MPP_TRACKS_PER_VIEW];
-
-			switch (index % MPP_TRACKS_PER_VIEW) {
-			case MPP_DEFAULT_TRACK(0):
-				devno = sm->synthDevice;
-				break;
-			case MPP_TREBLE_TRACK(0):
-				devno = sm->synthDeviceTreb;
-				break;
-			case MPP_BASS_TRACK(0):
-				devno = sm->synthDeviceBase;
-				break;
-			default:
-				break;
-			}
+	}
 
-			for (int x = 0; x != MPP_MAX_DEVS; x++) {
-				if (devno != -1 && mw->devSelMap[x] != devno)
-					continue;
-				if (((mw->deviceBits >> (2 * x)) & MPP_DEV0_PLAY) == 0)
-					continue;
-				if (mw->muteAllNonChannel[x])
-					continue;
+	/*
+	 * Duplicate event for all destination devices. The copies
+	 * are owned and freed by libumidi20 once transmitted.
+	 * Continuous events arriving faster than the rate limit of
+	 * a device are delayed and merged into a single event. Any
+	 * other event on the same channel transmits delayed values
+	 * first, so that the order is kept.
+	 */
+	count = 0;
+	for (uint8_t x = 0; mask != 0; x++, mask >>= 1) {
+		struct MppTxCoalesce *pc;
+		uint32_t position;
 
-				/* duplicate event */
-				p_event = umidi20_event_copy(event, 1);
-				if (p_event != NULL) {
-					p_event->device_no = x;
-					umidi20_event_queue_insert(&root_dev.play[x].queue,
-					    p_event, UMIDI20_CACHE_INPUT);
-				}
-			}
-			do_drop = 1;
+		if ((mask & 1) == 0)
+			continue;
+
+		pc = &mw->txCoalesce[x];
+		position = event->position;
+		window = __atomic_load_n(&mw->txCoalesceWindow[x], __ATOMIC_RELAXED);
+
+		if (slot < 0 || window == 0) {
+			if (cls != MPP_TX_CLASS_SYSTEM)
+				MidiEventTxFlush(mw, pc, event, x, chan, position);
 		} else {
-			do_drop = 1;
+			bit = 1U << (slot % 32);
+			if (MidiEventTxQueued(pc, chan, slot, position)) {
+				/* the delayed event is sent with the latest value */
+				memcpy(pc->value[chan][slot], event->cmd,
+				    sizeof(pc->value[chan][slot]));
+				pc->busy[chan][slot / 32] |= bit;
+				pc->drop[chan][slot / 32] &= ~bit;
+				__atomic_fetch_add(&mw->txMerged, 1, __ATOMIC_RELAXED);
+				continue;
+			}
+			if ((uint32_t)(position - pc->last[chan][slot]) < window)
+				position = pc->last[chan][slot] + window;
+			pc->last[chan][slot] = position;
+			pc->busy[chan][slot / 32] &= ~bit;
+			pc->drop[chan][slot / 32] &= ~bit;
+		}
+
+		p_event = umidi20_event_copy(event, 1);
+		if (p_event != NULL) {
+			p_event->device_no = x;
+			if (position != event->position) {
+				p_event->position = position;
+				memcpy(pc->value[chan][slot], event->cmd,
+				    sizeof(pc->value[chan][slot]));
+				pc->busy[chan][slot / 32] |= bit;
+				__atomic_fetch_add(&mw->txDelayed, 1, __ATOMIC_RELAXED);
+			}
+			umidi20_event_queue_insert(&root_dev.play[x].queue,
+			    p_event, UMIDI20_CACHE_INPUT);
+			count++;
 		}
-	} else if (device_no >= MPP_MAGIC_DEVNO) {
-		do_drop = 1;
 	}
-	*drop = do_drop;
-	mw->atomic_unlock();
+	if (count != 0) {
+		/* extended events are a chain of separate allocations */
+		chain = 0;
+		for (p_event = event; p_event != NULL; p_event = p_event->p_next)
+			chain++;
+		mw->latency->txAlloc(count * chain,
+		    count * chain * sizeof(struct umidi20_event));
+	}
+	*drop = 1;
+}
+
+/* must be called locked */
+void
+MppMainWindow :: do_instr_unmute(uint8_t chan)
+{
+	if (instr[chan].muted == 0)
+		return;
+	instr[chan].muted = 0;
+	tx_route_update_locked();
 }
 
 /* must be called locked */
@@ -2175,7 +3029,7 @@ MppMainWindow :: do_instr_check(struct umidi20_event *event, uint8_t *pchan)
 			instr[chan].bank &= 0x007F;
 			instr[chan].bank |= (val << 7);
 			instr[chan].updated |= 2;
-			instr[chan].muted = 0;
+			do_instr_unmute(chan);
 			instrUpdated = 1;
 			if (pchan != NULL)
 				*pchan = chan;
@@ -2184,7 +3038,7 @@ MppMainWindow :: do_instr_check(struct umidi20_event *event, uint8_t *pchan)
 			instr[chan].bank &= 0xFF80;
 			instr[chan].bank |= (val & 0x7F);
 			instr[chan].updated |= 2;
-			instr[chan].muted = 0;
+			do_instr_unmute(chan);
 			instrUpdated = 1;
 			if (pchan != NULL)
 				*pchan = chan;
@@ -2199,7 +3053,7 @@ MppMainWindow :: do_instr_check(struct umidi20_event *event, uint8_t *pchan)
 
 		instr[chan].prog = val;
 		instr[chan].updated |= 2;
-		instr[chan].muted = 0;
+		do_instr_unmute(chan);
 		instrUpdated = 1;
 		if (pchan != NULL)
 			*pchan = chan;
@@ -2263,127 +3117,21 @@ found:
 		handle_compile();
 }
 
-int
-MppMainWindow :: convert_midi_duration(struct umidi20_track *im_track, uint32_t thres, uint32_t chan_mask)
-{
-	struct umidi20_event *event;
-
-	uint32_t last_pos;
-	uint32_t delta;
-	uint32_t index;
-	uint32_t curr_pos;
-	uint32_t duration;
-
-	last_pos = -thres;	/* make sure we get the first score */
-	index = 0;
-	curr_pos = 0;
-	duration = 0;
-
-	memset(convLineStart, 0, sizeof(convLineStart));
-	memset(convLineEnd, 0, sizeof(convLineEnd));
-
-	UMIDI20_QUEUE_FOREACH(event, &im_track->queue) {
-
-		curr_pos = (event->position & 0x3FFFFFFF);
-		duration = event->duration;
-
-		delta = (curr_pos - last_pos);
-
-		if (!(umidi20_event_get_what(event) & UMIDI20_WHAT_CHANNEL))
-			continue;
-		if (!(chan_mask & (1 << (umidi20_event_get_channel(event) & 0xF))))
-			continue;
-
-		if (umidi20_event_is_key_start(event)) {
-			if (delta >= thres) {
-				last_pos = curr_pos;
-				if (index < MPP_MAX_LINES) {
-					convLineStart[index] = last_pos;
-					index++;
-				}
-			}
-		}
-
-		if (umidi20_event_is_key_end(event)) {
-			if (index > 0 && index < MPP_MAX_LINES)
-				convLineEnd[index - 1] = curr_pos;
-		}
-	}
-	if ((curr_pos + duration) > last_pos && index < MPP_MAX_LINES) {
-		convLineStart[index] = curr_pos + duration;
-		index++;
-	}
-	return (index);
-}
-
-QString
-MppMainWindow :: get_midi_score_duration(uint32_t *psum)
-{
-	uint32_t retval;
-	uint32_t lend;
-	char buf[32];
-
-	retval = convLineStart[convIndex] - 
-	    convLineStart[convIndex - 1];
-
-	lend = convLineEnd[convIndex - 1];
-
-	if (lend <= convLineStart[convIndex] &&
-	    lend >= convLineStart[convIndex - 1])
-		lend = convLineStart[convIndex] - lend;
-	else
-		lend = retval / 2;
-
-	snprintf(buf, sizeof(buf), "W%u.%u /* %u @ %u ms */",
-	    retval - lend, lend, retval, *psum);
-
-	*psum += retval;
-
-	return (QString(buf));
-}
-
-int
-MppMainWindow :: log_midi_score_duration(void)
-{
-	uint32_t retval;
-	uint8_t j;
-
-	retval = convLineStart[convIndex] - 
-	    convLineStart[convIndex - 1];
-
-	for (j = 0; j != 9; j++) {
-		if (retval > (1000U >> (j+1)))
-			break;
-	}
-
-	return (j);
-}
-
 void
 MppMainWindow :: import_midi_track(struct umidi20_track *im_track, uint32_t flags, int label, int view)
 {
 	QString output;
-	QString out_block;
-	QString out_desc;
 	QString out_prefix;
 
 	struct umidi20_event *event;
 
+	MppMidiConv *conv;
+
 	char buf[128];
 
-	uint32_t end;
-	uint32_t max_index;
-	uint32_t x;
-	uint32_t last_u = MPP_MAX_DURATION + 1;
 	uint32_t chan_mask = 0;
 	uint32_t thres = 25;
-	uint32_t sumdur = 0;
-	uint8_t last_chan = 0;
 	uint8_t chan;
-	uint8_t first_score;
-
-	convIndex = 0;
-	first_score = 0;
 
 	atomic_lock();
 
@@ -2423,147 +3171,38 @@ MppMainWindow :: import_midi_track(struct umidi20_track *im_track, uint32_t flag
 	if (chan_mask == 0)
 		return;
 
-	atomic_lock();
+	conv = new MppMidiConv(flags, thres, out_prefix);
 
+	atomic_lock();
 	umidi20_track_compute_max_min(im_track);
+	conv->snapshot(im_track, chan_mask);
+	atomic_unlock();
 
-	max_index = convert_midi_duration(im_track, thres, chan_mask);
-
-	UMIDI20_QUEUE_FOREACH(event, &im_track->queue) {
-
-		if (!(umidi20_event_get_what(event) & UMIDI20_WHAT_CHANNEL))
-			continue;
-		chan = umidi20_event_get_channel(event) & 0xF;
-
-		if (!(chan_mask & (1 << chan)))
-			continue;
-
-		while ((convIndex < max_index) &&
-		       ((event->position & 0x3FFFFFFFU) >= (convLineStart[convIndex] + thres))) {
-
-			uint8_t do_flush;
-			uint8_t new_page;
-			uint8_t duration;
-
-			convIndex++;
-
-			if (convIndex < max_index)
-				duration = log_midi_score_duration();
-			else
-				duration = 0;
-
-			do_flush = ((convIndex & 0xF) == 0);
-			new_page = ((convIndex & 0xFF) == 0);
-
-			if (duration != 0)
-				snprintf(buf, sizeof(buf), ".[%u]   ", (int)duration);
-			else
-				snprintf(buf, sizeof(buf), ".   ");
-
-			out_desc += buf;
-			if (flags & MIDI_FLAG_DURATION) {
-				if (convIndex < max_index)
-					out_block += get_midi_score_duration(&sumdur);
-			}
-			out_block += "\n";
-			first_score = 0;
-
-			if (do_flush) {
-
-				if (flags & MIDI_FLAG_STRING) {
-					snprintf(buf, sizeof(buf), "%5u", convIndex / 16);
-
-					output += "\nS\"";
-					output += buf;
-					output += out_desc;
-					output += "\"\n";
-				}
-				output += out_block;
-				if (flags & MIDI_FLAG_STRING) {
-					if (new_page)
-						output += "\nJP\n";
-				}
-				output += "\n";
-
-				out_desc = "";
-				out_block = "";
-			}
-
-			last_u = MPP_MAX_DURATION + 1;
-			last_chan = 0;
-		}
-
-		end = (event->position & 0x3FFFFFFFU) + event->duration;
-
-		if (umidi20_event_is_key_start(event)) {
-			uint32_t ext_key;
-
-			x = convIndex;
-			while (x < max_index) {
-				if (convLineStart[x] >= end)
-					break;
-				x++;
-			}
-
-			x = x - convIndex;
-
-			if (x > MPP_MAX_DURATION)
-				x = MPP_MAX_DURATION;
-			else if (x == 0) {
-				x = 1;
-				if ((convIndex + 1) < max_index)
-					end = convLineStart[convIndex + 1];
-				else
-					end = 0;	/* should not happen */
-
-			}
-
-			if (first_score == 0) {
-				first_score = 1;
-				if (out_prefix.size() > 0)
-					out_block += out_prefix + " ";
-			}
+	/* convert without holding any locks */
+	conv->start();
 
-			if (chan != last_chan) {
-				last_chan = chan;
-				if (flags & MIDI_FLAG_MULTI_CHAN) {
-					snprintf(buf, sizeof(buf), "T%u ", chan);
-					out_block += buf;
-				}
-			}
+	if (conv->wait(250) == false) {
+		QProgressDialog progress(tr("Converting MIDI track"),
+		    tr("Cancel"), 0, conv->total(), this);
 
-			if (x != last_u) {
-				last_u = x;
-				snprintf(buf, sizeof(buf), "U%u ", x);
-				out_block += buf;
-			}
+		progress.setWindowModality(Qt::WindowModal);
+		progress.setMinimumDuration(0);
 
-			ext_key = umidi20_event_get_extended_key(event);
-			if (ext_key != -1U)
-				out_block += MppKeyStr(ext_key);
-			else
-				out_block += mid_key_str[umidi20_event_get_key(event) & 0x7F];
-			out_block += " ";
+		while (conv->wait(50) == false) {
+			progress.setValue(conv->progress());
+			if (progress.wasCanceled())
+				conv->cancel();
 		}
 	}
 
-	atomic_unlock();
-
-	if (flags & MIDI_FLAG_STRING) {
-		snprintf(buf, sizeof(buf), "%5u", (convIndex + 15) / 16);
-
-		output += "\nS\"";
-		output += buf;
-		output += out_desc;
-		output += "\"\n";
+	if (conv->aborted) {
+		delete conv;
+		return;
 	}
-	output += out_block;
-	output += "\n";
 
-	if (flags & MIDI_FLAG_DURATION) {
-		snprintf(buf, sizeof(buf), "/* W = %u ms */\n\n", sumdur);
-		output += buf;
-	}
+	output += QString::fromUtf8(conv->output);
+
+	delete conv;
 
 	if (label > -1) {
 		snprintf(buf, sizeof(buf), "J%d\n", label);
@@ -2599,7 +3238,7 @@ MppMainWindow :: handle_gpro_file_import(int view)
 	  new QFileDialog(this, tr("Select GPro v3 or v4 File"), 
 		Mpp.HomeDirGp3,
 		QString("GPro File (*.gp *.gp3 *.gp4 *.GP *.GP3 *.GP4)"));
-	QByteArray data;
+	MppFileMap *map = NULL;
 	MppGPro *gpro;
 	QTextCursor *cursor;
 
@@ -2612,10 +3251,12 @@ MppMainWindow :: handle_gpro_file_import(int view)
 
 		QString fname(diag->selectedFiles()[0]);
 
-		if (MppReadRawFile(fname, &data) != 0) {
+		map = new MppFileMap(fname);
+
+		if (map->valid == false) {
 			QMessageBox box;
 
-			box.setText(tr("Could not read MIDI file!"));
+			box.setText(tr("Could not read GPro file!"));
 			box.setStandardButtons(QMessageBox::Ok);
 			box.setIcon(QMessageBox::Information);
 			box.setWindowIcon(QIcon(MppIconFile));
@@ -2631,7 +3272,8 @@ MppMainWindow :: handle_gpro_file_import(int view)
 
 load_file:
 
-	gpro = new MppGPro((uint8_t *)data.data(), data.size());
+	/* the parser reads directly from the file view */
+	gpro = new MppGPro(map->data, map->size);
 
 	cursor = new QTextCursor(scores_main[view]->editWidget->textCursor());
 	cursor->beginEditBlock();
@@ -2645,6 +3287,7 @@ load_file:
 	handle_make_scores_visible(scores_main[view]);
 
 done:
+	delete map;
 	delete diag;
 }
 
@@ -2655,8 +3298,9 @@ MppMainWindow :: handle_mxml_file_import(int view)
 	  new QFileDialog(this, tr("Select MusicXML file"), 
 		Mpp.HomeDirMXML,
 		QString("MusicXML file (*.xml *.XML)"));
-	QByteArray data;
+	MppFileMap *map = NULL;
 	MppMusicXmlImport *mxml;
+	QByteArray data;
 
 	diag->setAcceptMode(QFileDialog::AcceptOpen);
 	diag->setFileMode(QFileDialog::ExistingFile);
@@ -2667,7 +3311,9 @@ MppMainWindow :: handle_mxml_file_import(int view)
 
 		QString fname(diag->selectedFiles()[0]);
 
-		if (MppReadRawFile(fname, &data) != 0) {
+		map = new MppFileMap(fname);
+
+		if (map->valid == false) {
 			QMessageBox box;
 
 			box.setText(tr("Could not read MusicXML file!"));
@@ -2685,6 +3331,14 @@ MppMainWindow :: handle_mxml_file_import(int view)
 
 load_file:
 
+	/*
+	 * The import dialog parses the data before and after its
+	 * modal loop. Copy the file view and close it, so that
+	 * changes to the file meanwhile cannot fault.
+	 */
+	data = QByteArray((const char *)map->data, map->size);
+	map->close();
+
 	mxml = new MppMusicXmlImport(data);
 
 	if (mxml->output.isEmpty()) {
@@ -2716,6 +3370,7 @@ load_file:
 	handle_make_scores_visible(scores_main[view]);
 
 done:
+	delete map;
 	delete diag;
 }
 
@@ -2766,6 +3421,9 @@ MppMainWindow :: MidiInit(void)
 
 	startPosition = umidi20_get_curr_position() - 0x40000000;
 
+	tx_route_update_locked();
+	rx_route_update_locked();
+
 	atomic_unlock();
 
 	handle_midi_record(0);
@@ -2834,11 +3492,13 @@ MppMainWindow :: handle_config_dev(int n, int automagic)
 	return (retval);
 }
 
+/* can be called with only a view lock held */
 void
 MppMainWindow :: output_key(int index, int chan, int key, int vel, int delay, int dur)
 {
 	struct mid_data *d = &mid_data;
-	uint8_t n;
+
+	atomic_lock();
 
 	/* check for time scaling */
 	if (dlg_bpm->period_cur != 0 && dlg_bpm->bpm_other != 0)
@@ -2847,30 +3507,33 @@ MppMainWindow :: output_key(int index, int chan, int key, int vel, int delay, in
 	/* output key to all playback device(s) */
 	if (check_play(index, chan, 0)) {
 		mid_delay(d, delay);
-		do_key_press(key, vel, dur);
+		do_key_press(key, vel, dur, delay);
 	}
 
 	/* output key to recording device(s) */
 	if (check_record(index, chan, 0)) {
 		mid_delay(d, delay);
-		do_key_press(key, vel, dur);
+		do_key_press(key, vel, dur, delay);
 	}
 
 	/* output key to loop recording, if any */
-	for (n = 0; n != MPP_LOOP_MAX; n++) {
-		if (tab_loop->check_record(index, chan, n)) {
+	for (uint64_t armed = tab_loop->armed; armed != 0; armed &= armed - 1) {
+		if (tab_loop->check_record(index, chan, __builtin_ctzll(armed))) {
 			mid_delay(d, delay);
-			do_key_press(key, vel, dur);
+			do_key_press(key, vel, dur, delay);
 		}
 	}
+	atomic_unlock();
 }
 
-/* must be called locked */
+/* can be called with only a view lock held */
 void
 MppMainWindow :: output_key_pressure(int index, int chan, int key, int pressure, int delay)
 {
 	struct mid_data *d = &mid_data;
 
+	atomic_lock();
+
 	/* output pressure to all playback device(s) */
 	if (check_play(index, chan, 0)) {
 		mid_delay(d, delay);
@@ -2884,12 +3547,13 @@ MppMainWindow :: output_key_pressure(int index, int chan, int key, int pressure,
 	}
 
 	/* output pressure to loop recording, if any */
-	for (unsigned n = 0; n != MPP_LOOP_MAX; n++) {
-		if (tab_loop->check_record(index, chan, n)) {
+	for (uint64_t armed = tab_loop->armed; armed != 0; armed &= armed - 1) {
+		if (tab_loop->check_record(index, chan, __builtin_ctzll(armed))) {
 			mid_delay(d, delay);
 			do_key_pressure(key, pressure);
 		}
 	}
+	atomic_unlock();
 }
 
 void
@@ -2928,9 +3592,11 @@ MppMainWindow :: handle_key_mode_a(int value)
 	if (value < 0 || value >= MM_PASS_MAX)
 		value = 0;
 
+	scores_main[0]->atomicLock();
 	atomic_lock();
 	scores_main[0]->keyMode = value;
 	atomic_unlock();
+	scores_main[0]->atomicUnlock();
 }
 
 void
@@ -2939,9 +3605,11 @@ MppMainWindow :: handle_key_mode_b(int value)
 	if (value < 0 || value >= MM_PASS_MAX)
 		value = 0;
 
+	scores_main[1]->atomicLock();
 	atomic_lock();
 	scores_main[1]->keyMode = value;
 	atomic_unlock();
+	scores_main[1]->atomicUnlock();
 }
 
 void
@@ -3158,15 +3826,41 @@ MppMainWindow :: handle_up_down()
 void
 MppMainWindow :: atomic_lock(void)
 {
+	uint64_t start = MppLatency::now();
+
+	MppLockCheckAcquire(MPP_LOCK_MAIN, "main");
 	pthread_mutex_lock(&mtx);
+	latency->lockAcquired(start);
 }
 
 void
 MppMainWindow :: atomic_unlock(void)
 {
+	/* publish time state for lockless readers */
+	if (latency->lock_depth == 1)
+		publish_play_state_locked();
+
+	latency->lockReleased();
 	pthread_mutex_unlock(&mtx);
+	MppLockCheckRelease(MPP_LOCK_MAIN);
+}
+
+/* locks all views in ascending order, before the main lock */
+void
+MppMainWindow :: atomic_lock_views(void)
+{
+	for (unsigned x = 0; x != MPP_MAX_VIEWS; x++)
+		scores_main[x]->atomicLock();
+}
+
+void
+MppMainWindow :: atomic_unlock_views(void)
+{
+	for (unsigned x = MPP_MAX_VIEWS; x-- != 0; )
+		scores_main[x]->atomicUnlock();
 }
 
+
 /* must be called locked */
 MppScoreMain *
 MppMainWindow :: getCurrTransposeView(void)
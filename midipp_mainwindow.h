@@ -28,6 +28,81 @@
 
 #include "midipp.h"
 
+enum {
+	MPP_TX_CLASS_CHANNEL,	/* channel event */
+	MPP_TX_CLASS_PEDAL,	/* sustain pedal */
+	MPP_TX_CLASS_CONTROL,	/* other control events */
+	MPP_TX_CLASS_PROGRAM,	/* program change */
+	MPP_TX_CLASS_SYSTEM,	/* non-channel event */
+	MPP_TX_CLASS_MAX,
+};
+
+/* sources are the output devices followed by the view tracks */
+#define	MPP_TX_SOURCE_MAX	(MPP_MAX_DEVS + MPP_MAX_TRACKS)
+#define	MPP_TX_ROUTE(mask, vol)	((uint32_t)(mask) | ((uint32_t)(vol) << 16))
+#define	MPP_TX_ROUTE_MASK(x)	((x) & 0xFFFFU)
+#define	MPP_TX_ROUTE_VOLUME(x)	((x) >> 16)
+
+#define	MPP_MPE_CHANNELS	15	/* member channels of the lower zone */
+#define	MPP_MPE_BEND_RANGE	48	/* semitones, MPE default */
+
+/*
+ * MPE member channel. Released channels keep their key until they
+ * are reused, least recently released first, so that the release
+ * phase of a note is not bent by the next note.
+ */
+struct MppMpeChan {
+	int key;		/* key plus one, zero when unused */
+	int refcount;
+	uint32_t released;	/* release sequence number */
+	uint32_t ends;		/* end of timed note, in ms */
+};
+
+/* coalescing slots are the control addresses followed by these */
+#define	MPP_TX_SLOT_PITCH	128
+#define	MPP_TX_SLOT_PRESSURE	129
+#define	MPP_TX_SLOT_MAX		130
+#define	MPP_TX_SLOT_WORDS	((MPP_TX_SLOT_MAX + 31) / 32)
+#define	MPP_TX_WINDOW_MAX	255	/* ms, largest rate limit */
+
+/*
+ * Per output device coalescing state. Only accessed by the TX
+ * callback, which runs with the libumidi20 root device mutex held.
+ * Each slot has at most one delayed event queued, at the "last"
+ * position. No pointer to it is kept, because libumidi20 frees
+ * transmitted events. Instead the latest value is kept here and
+ * written into the delayed event when it reaches the device.
+ */
+struct MppTxCoalesce {
+	uint8_t value[16][MPP_TX_SLOT_MAX][4];	/* latest command bytes */
+	uint32_t last[16][MPP_TX_SLOT_MAX];	/* last or next send position */
+	uint32_t busy[16][MPP_TX_SLOT_WORDS];	/* delayed event gets "value" */
+	uint32_t drop[16][MPP_TX_SLOT_WORDS];	/* delayed event was flushed */
+};
+
+#define	MPP_EXT_KEYS	128	/* extended key slots */
+#define	MPP_EXT_HASH	256	/* must be power of two */
+
+/*
+ * Extended key slot. All indexes are stored plus one, so that an
+ * all-zero table is empty. Released slots keep their key on the
+ * idle list until they are evicted.
+ */
+struct MppExtKey {
+	int key;
+	int refcount;
+	uint8_t hnext;		/* next slot in hash chain */
+	uint8_t iprev;		/* previous slot on idle list */
+	uint8_t inext;		/* next slot on idle list */
+};
+
+struct MppTimeState {
+	uint32_t startPosition;
+	uint32_t pausePosition;
+	uint8_t midiTriggered;
+	uint8_t midiPaused;
+};
+
 class MppMainWindow : public QWidget
 {
 	Q_OBJECT;
@@ -44,35 +119,42 @@ public:
 
 	void atomic_lock(void);
 	void atomic_unlock(void);
+	void atomic_lock_views(void);
+	void atomic_unlock_views(void);
+	void tx_route_update_locked(void);
+	void rx_route_update_locked(void);
 
 	void closeEvent(QCloseEvent *event);
 	void handle_stop(int flag = 0);
 	void handle_midi_file_open(int);
 	void handle_midi_file_clear_name(void);
-	void handle_midi_file_instr_prepend(void);
-	void handle_midi_file_instr_delete(void);
-	void handle_jump_locked(int index);
+	void handle_midi_file_instr_prepend(struct umidi20_track **);
+	void handle_jump_locked(int index, uint32_t views);
 	void handle_make_scores_visible(MppScoreMain *);
 	void handle_make_tab_visible(QWidget *);
+	void handle_render_locked(MppScoreMain *);
 
-	QString get_midi_score_duration(uint32_t *psum);
-	int log_midi_score_duration();
-	int convert_midi_duration(struct umidi20_track *, uint32_t thres, uint32_t chan_mask);
 	void import_midi_track(struct umidi20_track *, uint32_t = 0, int = -1, int = 0);
 
 	void update_play_device_no(void);
 
 	void do_clock_stats(void);
 	int do_extended_alloc(int key, int refcount);
-	void do_key_press(int key, int vel, int dur);
+	void do_extended_reset(void);
+	void do_extended_idle_remove(uint8_t);
+	int do_mpe_alloc(int key, int refcount);
+	void do_key_press(int key, int vel, int dur, int delay);
 	void do_key_pressure(int key, int pressure);
 	void output_key(int index, int chan, int key, int vel, int delay, int dur);
 	void output_key_pressure(int index, int chan, int key, int pressure, int delay = 0);
 
 	uint32_t get_time_offset(void);
+	uint32_t get_time_offset_snapshot(void);
+	void publish_play_state_locked(void);
 
 	uint8_t noise8(uint8_t factor);
 	uint8_t do_instr_check(struct umidi20_event *event, uint8_t *pchan);
+	void do_instr_unmute(uint8_t);
 	bool check_play(uint8_t index, uint8_t chan, uint32_t off, uint8_t = MPP_MAGIC_DEVNO);
 	bool check_record(uint8_t index, uint8_t chan, uint32_t off);
 
@@ -100,19 +182,48 @@ public:
 
 	struct MppInstr instr[16];
 
-	int extended_keys[128][2];
+	struct MppExtKey extKey[MPP_EXT_KEYS];
+	uint8_t extHash[MPP_EXT_HASH];
+	uint8_t extIdleHead;
+	uint8_t extIdleTail;
+	uint8_t extUsed;
+	uint32_t extEvictions;
+	uint32_t extOverflows;
+
+	struct MppMpeChan mpeChan[MPP_MPE_CHANNELS];
+	uint32_t mpeSeq;
+	uint32_t mpeOverflows;
   
-	uint32_t convLineStart[MPP_MAX_LINES];
-	uint32_t convLineEnd[MPP_MAX_LINES];
-	uint32_t convIndex;
+	/*
+	 * TX routing table, indexed by source, event class and
+	 * channel. Each entry holds a destination device mask and a
+	 * volume factor, see MPP_TX_ROUTE(). Rebuilt under the main
+	 * lock by tx_route_update_locked(). Read without any lock by
+	 * the TX callback.
+	 */
+	uint32_t txRoute[MPP_TX_SOURCE_MAX][MPP_TX_CLASS_MAX][16];
+
+	/*
+	 * RX dispatch table, indexed by input device and channel.
+	 * The last entry is used for non-channel events. Each entry
+	 * holds a mask of the views receiving the event. Rebuilt and
+	 * read under the main lock.
+	 */
+	uint32_t rxRoute[MPP_MAX_DEVS][16 + 1];
+
+	struct MppTxCoalesce txCoalesce[MPP_MAX_DEVS];
+	uint32_t txMerged;
+	uint32_t txDelayed;
+	uint32_t txFlushed;
 
 	uint32_t lastKeyPress;
-	uint32_t lastInputEvent;
+	uint32_t scoreWindow;
 	uint32_t noiseRem;
 
 	uint32_t devInputMask[MPP_MAX_DEVS];
 	uint32_t startPosition;
 	uint32_t pausePosition;
+	uint32_t renderPosition;
 	uint32_t deviceBits;
 #define	MPP_DEV0_PLAY	0x0001UL
 #define	MPP_DEV0_RECORD	0x0002UL
@@ -128,10 +239,7 @@ public:
 	uint8_t muteAllControl[MPP_MAX_DEVS];
 	uint8_t muteAllNonChannel[MPP_MAX_DEVS];
 	uint8_t muteMap[MPP_MAX_DEVS][16];
-	uint8_t inputEvents[MPP_MAX_QUEUE];
-	uint8_t numInputEvents;
-	uint8_t controlEvents[MPP_MAX_QUEUE][4];
-	uint8_t numControlEvents;
+	uint8_t txCoalesceWindow[MPP_MAX_DEVS];	/* ms, zero is off */
 	uint8_t cursorUpdate;
 
 	uint8_t scoreRecordOn;
@@ -149,6 +257,10 @@ public:
 #define	MPP_OPERATION_BPM 0x04
 
 	uint8_t noteMode;
+	uint8_t renderActive;
+
+	struct MppTimeState timeState;
+	uint32_t timeStateSeq;
 
 	char *deviceName[MPP_MAX_DEVS];
 
@@ -194,6 +306,8 @@ public:
 	QPushButton *but_midi_file_save;
 	QPushButton *but_midi_file_save_as;
 	MppButton *but_midi_file_import[MPP_MAX_VIEWS];
+	MppButton *but_midi_file_render[MPP_MAX_VIEWS];
+	QPushButton *but_midi_file_journal;
 
 	MppGroupBox *gb_gpro_file_import;
 	MppButton *but_gpro_file_import[MPP_MAX_VIEWS];
@@ -219,6 +333,7 @@ public:
 	MppButtonMap *mbm_midi_play;
 	MppButtonMap *mbm_midi_record;
 	MppButtonMap *mbm_score_record;
+	MppButtonMap *mbm_score_window;
 	MppButtonMap *mbm_key_mode_a;
 	MppButtonMap *mbm_key_mode_b;
 
@@ -250,6 +365,11 @@ public:
 
 	MppSettings *mpp_settings;
 
+	MppLatency *latency;
+
+	MppRecord *scoreRec;
+	MppRing *controlEvents;
+
 	MppDevSel *but_config_sel[MPP_MAX_DEVS];
 	MppButton *but_config_dev[MPP_MAX_DEVS];
 	MppButton *but_config_mm[MPP_MAX_DEVS];
@@ -264,6 +384,8 @@ public:
 	QPushButton *but_config_print_fontsel;
 
 	QString *CurrMidiFileName;
+	MppMidiSave *midiSave;
+	MppMidiJournal *midiJournal;
 
 	/* tab <Shortcut> */
 
@@ -301,6 +423,7 @@ public:
 	struct mid_data mid_data;
 	struct umidi20_song *song;
 	struct umidi20_track *track[MPP_MAX_TRACKS];
+	struct umidi20_track *renderTrack[MPP_MAX_TRACKS];
 
 	uint8_t auto_zero_end[0];
 
@@ -309,6 +432,7 @@ public slots:
 	void handle_jump(int index);
 	void handle_compile(int force = 0);
 	void handle_score_record(int);
+	void handle_score_window(int);
 	void handle_midi_record(int);
 	void handle_midi_pause();
 	void handle_midi_play(int);
@@ -323,7 +447,10 @@ public slots:
 	void handle_midi_file_merge_multi_open();
 	void handle_midi_file_new_multi_open();
 	void handle_midi_file_save();
+	void handle_midi_file_save_done();
+	void handle_midi_file_journal();
 	void handle_midi_file_save_as();
+	void handle_midi_file_render(int);
 	void handle_rewind();
 	void handle_midi_trigger();
 	void handle_config_changed();
@@ -45,6 +45,22 @@ MppMetronomeOutput(MppMetronome *mm, struct mid_data *d)
 	}
 }
 
+/*
+ * The timer fires MPP_METRONOME_AHEAD milliseconds before the beat.
+ * Returns the offset from the current time to the ideal beat time,
+ * so that the clicks are not delayed by the callback latency.
+ */
+static uint32_t
+MppMetronomeOffset(MppMetronome *mm)
+{
+	int32_t off;
+
+	off = (int32_t)(mm->tempo.ideal - umidi20_get_curr_position());
+	if (off < 0)
+		off = 0;
+	return (off);
+}
+
 static void
 MppMetronomeCallback(void *arg)
 {
@@ -52,13 +68,18 @@ MppMetronomeCallback(void *arg)
         MppMainWindow *mw = mm->mainWindow;
 
         mw->atomic_lock();
+	mm->tempo.beat(umidi20_get_curr_position());
+	umidi20_update_timer(&MppMetronomeCallback, mm, mm->tempo.delay(), 0);
+
         if (mm->enabled != 0 && mw->midiTriggered != 0) {
 		MppScoreMain *sm = mw->scores_main[mm->view];
 
-		if (mw->check_play(MPP_DEFAULT_TRACK(sm->unit), sm->synthChannel, 0))
+		if (mw->check_play(MPP_DEFAULT_TRACK(sm->unit), sm->synthChannel,
+		    MppMetronomeOffset(mm)))
 			MppMetronomeOutput(mm, &mw->mid_data);
 		if (mm->enabled == 2 &&
-		    mw->check_record(MPP_DEFAULT_TRACK(sm->unit), sm->synthChannel, 0))
+		    mw->check_record(MPP_DEFAULT_TRACK(sm->unit), sm->synthChannel,
+		    MppMetronomeOffset(mm)))
 			MppMetronomeOutput(mm, &mw->mid_data);
 	}
         mw->atomic_unlock();
@@ -78,10 +99,6 @@ MppMetronome ::  MppMetronome(MppMainWindow *parent)
 	mode = 0;
 	view = 0;
 
-	tim_config = new QTimer();
-	tim_config->setSingleShot(1);
-	connect(tim_config, SIGNAL(timeout()), this, SLOT(handleTimeout()));
-
 	spn_volume = new MppVolume();
 	spn_volume->setRange(1, 127, 64);
 	spn_volume->setValue(volume);
@@ -135,13 +152,14 @@ MppMetronome ::  MppMetronome(MppMainWindow *parent)
 	gb->setRowStretch(7,1);
 	gb->setColumnStretch(2,1);
 
+	tempo.setPeriod(60000, bpm);
+	tempo.ahead = MPP_METRONOME_AHEAD;
+
 	umidi20_set_timer(&MppMetronomeCallback, this, 60000 / bpm);
 }
 
 MppMetronome :: ~MppMetronome()
 {
-	tim_config->stop();
-
 	umidi20_unset_timer(&MppMetronomeCallback, this);
 }
 
@@ -153,27 +171,25 @@ MppMetronome :: handleVolumeChanged(int val)
 	mainWindow->atomic_unlock();
 }
 
-void
-MppMetronome :: handleTimeout()
-{
-	mainWindow->atomic_lock();
-	handleUpdateLocked();
-	mainWindow->atomic_unlock();
-}
-
 void
 MppMetronome :: handleBPMChanged(int val)
 {
+	/* keep the beat phase, the next beat uses the new tempo */
 	mainWindow->atomic_lock();
 	bpm = val;
+	tempo.setPeriod(60000, bpm);
+	if (tempo.valid != 0) {
+		umidi20_update_timer(&MppMetronomeCallback, this,
+		    tempo.next(umidi20_get_curr_position()), 1);
+	}
 	mainWindow->atomic_unlock();
-
-	tim_config->start(500);
 }
 
 void
 MppMetronome :: handleUpdateLocked()
 {
+	tempo.setPeriod(60000, bpm);
+	tempo.resync();
 	umidi20_update_timer(&MppMetronomeCallback, this, 60000 / bpm, 1);
 }
 
@@ -27,6 +27,9 @@
 #define	_MIDIPP_METRONOME_H_
 
 #include "midipp.h"
+#include "midipp_tempo.h"
+
+#define	MPP_METRONOME_AHEAD	20	/* ms */
 
 class MppMetronome : public QObject
 {
@@ -46,7 +49,6 @@ public:
 	MppSpinBox *spn_key_bar;
 	MppSpinBox *spn_key_beat;
 	MppButtonMap *but_mode;
-	QTimer *tim_config;
 
 	int volume;
 	int bpm;
@@ -55,6 +57,8 @@ public:
 	int key_beat;
 	int mode;
 	int view;
+
+	MppTempo tempo;
 	
 public slots:
 	void handleVolumeChanged(int);
@@ -65,7 +69,6 @@ public slots:
 	void handleModeChanged(int);
 	void handleViewChanged(int);
 	void handleUpdateLocked();
-	void handleTimeout();
 };
 
 #endif			/* _MIDIPP_METRONOME_H_ */
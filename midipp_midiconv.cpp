@@ -0,0 +1,475 @@
+/*-
+ * Copyright (c) 2019 Hans Petter Selasky. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "midipp_midiconv.h"
+#include "midipp_midi.h"
+#include "midipp_decode.h"
+
+MppMidiConv :: MppMidiConv(uint32_t _flags, uint32_t _thres, const QString &_prefix)
+{
+	event = 0;
+	lineStart = 0;
+	lineEnd = 0;
+	numEvent = 0;
+	maxEvent = 0;
+	numLine = 0;
+	maxLine = 0;
+	flags = _flags;
+	thres = _thres;
+	lastEnd = 0;
+	done = 0;
+	aborted = 0;
+	prefix = _prefix.toUtf8();
+}
+
+MppMidiConv :: ~MppMidiConv()
+{
+	free(event);
+	free(lineStart);
+	free(lineEnd);
+}
+
+/* must be called locked */
+void
+MppMidiConv :: snapshot(struct umidi20_track *track, uint32_t chan_mask)
+{
+	struct umidi20_event *ev;
+	struct MppMidiConvEvent *pe;
+	uint32_t ext_key;
+	uint32_t pos;
+	uint8_t chan;
+
+	UMIDI20_QUEUE_FOREACH(ev, &track->queue) {
+
+		pos = (ev->position & 0x3FFFFFFFU);
+		lastEnd = pos + ev->duration;
+
+		if (!(umidi20_event_get_what(ev) & UMIDI20_WHAT_CHANNEL))
+			continue;
+		chan = umidi20_event_get_channel(ev) & 0xF;
+		if (!(chan_mask & (1U << chan)))
+			continue;
+
+		if (numEvent == maxEvent) {
+			uint32_t max = maxEvent ? (2 * maxEvent) : 1024;
+
+			pe = (struct MppMidiConvEvent *)
+			    realloc(event, max * sizeof(*pe));
+			if (pe == NULL) {
+				aborted = 1;
+				break;
+			}
+			event = pe;
+			maxEvent = max;
+		}
+
+		pe = &event[numEvent++];
+		pe->position = pos;
+		pe->duration = ev->duration;
+		pe->key = 0;
+		pe->chan = chan;
+		pe->flags = 0;
+
+		if (umidi20_event_is_key_start(ev)) {
+			pe->flags |= MPP_MIDICONV_START;
+
+			ext_key = umidi20_event_get_extended_key(ev);
+			if (ext_key != -1U) {
+				pe->key = ext_key;
+				pe->flags |= MPP_MIDICONV_EXT;
+			} else {
+				pe->key = umidi20_event_get_key(ev) & 0x7F;
+			}
+		}
+		if (umidi20_event_is_key_end(ev))
+			pe->flags |= MPP_MIDICONV_END;
+	}
+}
+
+bool
+MppMidiConv :: lineAdd(uint32_t pos)
+{
+	if (numLine == maxLine) {
+		uint32_t max = maxLine ? (2 * maxLine) : 256;
+		uint32_t *ps;
+		uint32_t *pe;
+
+		ps = (uint32_t *)realloc(lineStart, max * sizeof(*ps));
+		if (ps == NULL)
+			return (false);
+		lineStart = ps;
+
+		pe = (uint32_t *)realloc(lineEnd, max * sizeof(*pe));
+		if (pe == NULL)
+			return (false);
+		lineEnd = pe;
+
+		maxLine = max;
+	}
+	lineStart[numLine] = pos;
+	lineEnd[numLine] = 0;
+	numLine++;
+	return (true);
+}
+
+/*
+ * Returns the index of the first line starting at or after the
+ * given position, searching from the given line. The line start
+ * positions are strictly increasing.
+ */
+uint32_t
+MppMidiConv :: lineFind(uint32_t start, uint32_t pos)
+{
+	uint32_t end = numLine;
+	uint32_t mid;
+
+	while (start != end) {
+		mid = start + (end - start) / 2;
+		if (lineStart[mid] >= pos)
+			end = mid;
+		else
+			start = mid + 1;
+	}
+	return (start);
+}
+
+void
+MppMidiConv :: computeLines(void)
+{
+	const struct MppMidiConvEvent *pe;
+	uint32_t last_pos;
+
+	last_pos = -thres;	/* make sure we get the first score */
+
+	for (uint32_t n = 0; n != numEvent; n++) {
+		pe = &event[n];
+
+		if ((n & 1023) == 0)
+			__atomic_store_n(&done, n, __ATOMIC_RELAXED);
+
+		if (pe->flags & MPP_MIDICONV_START) {
+			if ((pe->position - last_pos) >= thres) {
+				last_pos = pe->position;
+				if (lineAdd(last_pos) == false) {
+					cancel();
+					return;
+				}
+			}
+		}
+		if (pe->flags & MPP_MIDICONV_END) {
+			if (numLine > 0)
+				lineEnd[numLine - 1] = pe->position;
+		}
+	}
+	if (lastEnd > last_pos) {
+		if (lineAdd(lastEnd) == false)
+			cancel();
+	}
+}
+
+/*
+ * Returns the index of the first event at or after the given
+ * position. The events are sorted by position.
+ */
+uint32_t
+MppMidiConv :: eventFind(uint32_t pos)
+{
+	uint32_t start = 0;
+	uint32_t end = numEvent;
+	uint32_t mid;
+
+	while (start != end) {
+		mid = start + (end - start) / 2;
+		if (event[mid].position >= pos)
+			end = mid;
+		else
+			start = mid + 1;
+	}
+	return (start);
+}
+
+/*
+ * Converts the score lines from "first" up to, but not including,
+ * "last". The range which runs out of events also outputs the
+ * trailing block.
+ */
+void
+MppMidiConv :: buildOutput(uint32_t first, uint32_t last, QByteArray &out)
+{
+	const struct MppMidiConvEvent *pe;
+	QByteArray block;
+	QByteArray desc;
+	char buf[128];
+	uint32_t last_u = MPP_MAX_DURATION + 1;
+	uint32_t sumdur;
+	uint32_t index = first;
+	uint32_t x;
+	uint32_t n;
+	uint8_t last_chan = 0;
+	uint8_t first_score = 0;
+
+	/* about four bytes per key and one line per block */
+	out.reserve(4 * numEvent * (last - first) / (numLine ? numLine : 1) +
+	    16 * (last - first));
+
+	if (first != 0) {
+		/* continue with the event which completed the previous line */
+		n = eventFind(lineStart[first - 1] + thres);
+		if (n == numEvent) {
+			/* the previous range output the trailing block */
+			return;
+		}
+		sumdur = lineStart[first] - lineStart[0];
+	} else {
+		n = 0;
+		sumdur = 0;
+	}
+
+	for (; n != numEvent; n++) {
+		pe = &event[n];
+
+		if ((n & 1023) == 0) {
+			__atomic_fetch_add(&done, 1024, __ATOMIC_RELAXED);
+			if (__atomic_load_n(&aborted, __ATOMIC_RELAXED))
+				return;
+		}
+
+		while ((index < numLine) &&
+		       (pe->position >= (lineStart[index] + thres))) {
+
+			uint32_t retval;
+			uint32_t lend;
+			uint8_t duration;
+
+			index++;
+
+			if (index < numLine) {
+				retval = lineStart[index] - lineStart[index - 1];
+
+				for (duration = 0; duration != 9; duration++) {
+					if (retval > (1000U >> (duration + 1)))
+						break;
+				}
+			} else {
+				retval = 0;
+				duration = 0;
+			}
+
+			if (duration != 0)
+				snprintf(buf, sizeof(buf), ".[%u]   ", (int)duration);
+			else
+				snprintf(buf, sizeof(buf), ".   ");
+			desc += buf;
+
+			if ((flags & MIDI_FLAG_DURATION) && index < numLine) {
+				lend = lineEnd[index - 1];
+
+				if (lend <= lineStart[index] &&
+				    lend >= lineStart[index - 1])
+					lend = lineStart[index] - lend;
+				else
+					lend = retval / 2;
+
+				snprintf(buf, sizeof(buf), "W%u.%u /* %u @ %u ms */",
+				    retval - lend, lend, retval, sumdur);
+				block += buf;
+
+				sumdur += retval;
+			}
+			block += '\n';
+			first_score = 0;
+
+			/* flush every 16 lines */
+			if ((index & 0xF) == 0) {
+				if (flags & MIDI_FLAG_STRING) {
+					snprintf(buf, sizeof(buf), "%5u", index / 16);
+
+					out += "\nS\"";
+					out += buf;
+					out += desc;
+					out += "\"\n";
+				}
+				out += block;
+				if (flags & MIDI_FLAG_STRING) {
+					if ((index & 0xFF) == 0)
+						out += "\nJP\n";
+				}
+				out += '\n';
+
+				desc.clear();
+				block.clear();
+			}
+
+			last_u = MPP_MAX_DURATION + 1;
+			last_chan = 0;
+
+			/* the next range continues from here */
+			if (index == last && last != numLine)
+				return;
+		}
+
+		if (!(pe->flags & MPP_MIDICONV_START))
+			continue;
+
+		x = lineFind(index, pe->position + pe->duration) - index;
+
+		if (x > MPP_MAX_DURATION)
+			x = MPP_MAX_DURATION;
+		else if (x == 0)
+			x = 1;
+
+		if (first_score == 0) {
+			first_score = 1;
+			if (prefix.size() > 0) {
+				block += prefix;
+				block += ' ';
+			}
+		}
+
+		if (pe->chan != last_chan) {
+			last_chan = pe->chan;
+			if (flags & MIDI_FLAG_MULTI_CHAN) {
+				snprintf(buf, sizeof(buf), "T%u ", pe->chan);
+				block += buf;
+			}
+		}
+
+		if (x != last_u) {
+			last_u = x;
+			snprintf(buf, sizeof(buf), "U%u ", x);
+			block += buf;
+		}
+
+		if (pe->flags & MPP_MIDICONV_EXT)
+			block += MppKeyStr(pe->key).toLatin1();
+		else
+			block += mid_key_str[pe->key];
+		block += ' ';
+	}
+
+	if (flags & MIDI_FLAG_STRING) {
+		snprintf(buf, sizeof(buf), "%5u", (index + 15) / 16);
+
+		out += "\nS\"";
+		out += buf;
+		out += desc;
+		out += "\"\n";
+	}
+	out += block;
+	out += '\n';
+
+	if (flags & MIDI_FLAG_DURATION) {
+		snprintf(buf, sizeof(buf), "/* W = %u ms */\n\n", sumdur);
+		out += buf;
+	}
+}
+
+void
+MppMidiConv :: convert(void)
+{
+	MppMidiConvWorker *worker;
+	uint32_t num;
+	uint32_t step;
+	uint32_t x;
+
+	if (__atomic_load_n(&aborted, __ATOMIC_RELAXED) == 0)
+		computeLines();
+	if (__atomic_load_n(&aborted, __ATOMIC_RELAXED) != 0)
+		return;
+
+	__atomic_store_n(&done, numEvent, __ATOMIC_RELAXED);
+
+	/* compute number of line ranges */
+	num = numLine / MPP_MIDICONV_LINES;
+	x = QThread::idealThreadCount();
+	if (num > x)
+		num = x;
+	if (num < 2) {
+		buildOutput(0, numLine, output);
+		__atomic_store_n(&done, total(), __ATOMIC_RELAXED);
+		return;
+	}
+
+	/* ranges must start at a 16 line boundary and be non-empty */
+	step = ((numLine + num - 1) / num + 15) & ~15U;
+	num = (numLine + step - 1) / step;
+
+	worker = new MppMidiConvWorker [num];
+
+	for (x = 0; x != num; x++) {
+		worker[x].conv = this;
+		worker[x].first = x * step;
+		worker[x].last = (x == num - 1) ? numLine : (x + 1) * step;
+	}
+
+	/* the first range is converted by this thread */
+	for (x = 1; x != num; x++)
+		worker[x].start();
+	buildOutput(worker[0].first, worker[0].last, worker[0].output);
+
+	for (x = 0; x != num; x++) {
+		if (x != 0)
+			worker[x].wait();
+		output += worker[x].output;
+		worker[x].output.clear();
+	}
+
+	delete [] worker;
+
+	__atomic_store_n(&done, total(), __ATOMIC_RELAXED);
+}
+
+void
+MppMidiConv :: run(void)
+{
+	convert();
+}
+
+void
+MppMidiConvWorker :: run(void)
+{
+	conv->buildOutput(first, last, output);
+}
+
+uint32_t
+MppMidiConv :: progress(void)
+{
+	uint32_t value = __atomic_load_n(&done, __ATOMIC_RELAXED);
+
+	/* the line ranges may count some events twice */
+	return (value > total() ? total() : value);
+}
+
+uint32_t
+MppMidiConv :: total(void)
+{
+	return (2 * numEvent);
+}
+
+void
+MppMidiConv :: cancel(void)
+{
+	__atomic_store_n(&aborted, 1, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,116 @@
+/*-
+ * Copyright (c) 2019 Hans Petter Selasky. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _MIDIPP_MIDICONV_H_
+#define	_MIDIPP_MIDICONV_H_
+
+#include "midipp.h"
+
+#define	MPP_MIDICONV_START	0x01	/* key start */
+#define	MPP_MIDICONV_END	0x02	/* key end */
+#define	MPP_MIDICONV_EXT	0x04	/* extended key */
+
+#ifndef MPP_MIDICONV_LINES
+#define	MPP_MIDICONV_LINES	1024	/* minimum lines per worker, multiple of 16 */
+#endif
+
+#if (MPP_MIDICONV_LINES % 16) != 0
+#error "MPP_MIDICONV_LINES must be a multiple of 16"
+#endif
+
+struct MppMidiConvEvent {
+	uint32_t position;
+	uint32_t duration;
+	uint32_t key;
+	uint8_t chan;
+	uint8_t flags;
+};
+
+/*
+ * MIDI track to score converter. The events of the selected channels
+ * are copied from the track while the main lock is held. The
+ * conversion runs on a separate thread without any locks, and the
+ * score text is collected in "output", which is UTF-8 encoded.
+ *
+ * Once the score lines are known, ranges of lines are converted in
+ * parallel into separate buffers, which are then joined in order.
+ * The output does not depend on the number of ranges, because all
+ * per line state is reset at every line and the ranges start at a
+ * 16 line block boundary.
+ */
+class MppMidiConv : public QThread {
+public:
+	MppMidiConv(uint32_t, uint32_t, const QString &);
+	~MppMidiConv();
+
+	void snapshot(struct umidi20_track *, uint32_t);
+	void convert(void);
+	uint32_t progress(void);
+	uint32_t total(void);
+	void cancel(void);
+
+	QByteArray output;
+	QByteArray prefix;
+
+	struct MppMidiConvEvent *event;
+	uint32_t *lineStart;
+	uint32_t *lineEnd;
+
+	uint32_t numEvent;
+	uint32_t maxEvent;
+	uint32_t numLine;
+	uint32_t maxLine;
+
+	uint32_t flags;		/* MIDI_FLAG_XXX */
+	uint32_t thres;		/* event threshold in milliseconds */
+	uint32_t lastEnd;	/* end of last event in track */
+	uint32_t done;
+	uint8_t aborted;
+
+protected:
+	void run();
+
+private:
+	friend class MppMidiConvWorker;
+
+	bool lineAdd(uint32_t);
+	uint32_t lineFind(uint32_t, uint32_t);
+	uint32_t eventFind(uint32_t);
+	void computeLines(void);
+	void buildOutput(uint32_t, uint32_t, QByteArray &);
+};
+
+class MppMidiConvWorker : public QThread {
+public:
+	MppMidiConv *conv;
+	uint32_t first;		/* first line */
+	uint32_t last;		/* last line, exclusive */
+	QByteArray output;
+
+protected:
+	void run();
+};
+
+#endif		/* _MIDIPP_MIDICONV_H_ */
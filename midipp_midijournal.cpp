@@ -0,0 +1,354 @@
+/*-
+ * Copyright (c) 2019 Hans Petter Selasky. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+
+#include "midipp_midijournal.h"
+
+/* file header followed by the track header */
+#define	MPP_MIDIJOURNAL_HDR 22
+
+static const uint8_t MppMidiJournalHeader[MPP_MIDIJOURNAL_HDR] = {
+	'M', 'T', 'h', 'd', 0x00, 0x00, 0x00, 0x06,
+	0x00, 0x00,			/* format 0 */
+	0x00, 0x01,			/* one track */
+	0x01, 0xF4,			/* 500 ticks per quarter note */
+	'M', 'T', 'r', 'k', 0xFF, 0xFF, 0xFF, 0xFF,
+};
+
+static const uint8_t MppMidiJournalEnd[4] = {
+	0x00, 0xFF, 0x2F, 0x00,		/* end of track */
+};
+
+static uint32_t
+MppMidiJournalCmdLen(uint8_t status)
+{
+	if (status < 0x80 || status >= 0xF0)
+		return (0);
+	else if ((status & 0xE0) == 0xC0)
+		return (2);
+	else
+		return (3);
+}
+
+static uint32_t
+MppMidiJournalVarLen(uint8_t *buf, uint32_t value)
+{
+	uint32_t n = 0;
+
+	if (value > 0x0FFFFFFFU)
+		value = 0x0FFFFFFFU;
+	if (value >= (1U << 21))
+		buf[n++] = 0x80 | ((value >> 21) & 0x7F);
+	if (value >= (1U << 14))
+		buf[n++] = 0x80 | ((value >> 14) & 0x7F);
+	if (value >= (1U << 7))
+		buf[n++] = 0x80 | ((value >> 7) & 0x7F);
+	buf[n++] = value & 0x7F;
+	return (n);
+}
+
+MppMidiJournal :: MppMidiJournal(const QString &_fname)
+{
+	fname = _fname;
+	file.setFileName(journalName(fname));
+	memset(track, 0, sizeof(track));
+	pending = 0;
+	work = 0;
+	startPosition = umidi20_get_curr_position();
+	cutoff = 0;
+	lastPosition = 0;
+	length = 0;
+	dirty = 0;
+	stopping = 0;
+	error = MPP_MIDIJOURNAL_OK;
+
+	umidi20_mutex_init(&mtx);
+	pthread_cond_init(&cond, NULL);
+}
+
+MppMidiJournal :: ~MppMidiJournal()
+{
+	for (unsigned x = 0; x != MPP_MAX_TRACKS; x++) {
+		if (track[x] != 0)
+			umidi20_track_free(track[x]);
+	}
+	if (pending != 0)
+		umidi20_track_free(pending);
+	if (work != 0)
+		umidi20_track_free(work);
+
+	pthread_cond_destroy(&cond);
+	pthread_mutex_destroy(&mtx);
+}
+
+QString
+MppMidiJournal :: journalName(const QString &fname)
+{
+	return (fname + QString(".journal"));
+}
+
+QString
+MppMidiJournal :: recoveredName(const QString &fname)
+{
+	if (fname.endsWith(QString(".mid"), Qt::CaseInsensitive))
+		return (fname.left(fname.size() - 4) +
+		    QString("-recovered") + fname.right(4));
+	return (fname + QString("-recovered"));
+}
+
+bool
+MppMidiJournal :: open(void)
+{
+	for (unsigned x = 0; x != MPP_MAX_TRACKS; x++) {
+		track[x] = umidi20_track_alloc();
+		if (track[x] == 0)
+			goto error;
+	}
+	pending = umidi20_track_alloc();
+	if (pending == 0)
+		goto error;
+	work = umidi20_track_alloc();
+	if (work == 0)
+		goto error;
+
+	if (file.open(QIODevice::WriteOnly | QIODevice::Truncate) == false ||
+	    file.write((const char *)MppMidiJournalHeader,
+	    MPP_MIDIJOURNAL_HDR) != MPP_MIDIJOURNAL_HDR ||
+	    file.flush() == false) {
+		error = MPP_MIDIJOURNAL_ERR_WRITE;
+		return (false);
+	}
+	return (true);
+
+error:
+	error = MPP_MIDIJOURNAL_ERR_MEMORY;
+	return (false);
+}
+
+/*
+ * The journal has its own clock, which is not reset by stopping
+ * or rewinding the song. One tick is one millisecond at the
+ * default tempo of 120 BPM.
+ */
+uint32_t
+MppMidiJournal :: position(uint32_t off)
+{
+	return ((umidi20_get_curr_position() - startPosition + off) &
+	    0x3FFFFFFFU);
+}
+
+/* must be called locked */
+void
+MppMidiJournal :: collect(void)
+{
+	uint32_t pos = position(0);
+
+	pthread_mutex_lock(&mtx);
+	for (unsigned x = 0; x != MPP_MAX_TRACKS; x++) {
+		umidi20_event_queue_move(&track[x]->queue, &pending->queue,
+		    0, 0-1, 0, 0-1, UMIDI20_CACHE_INPUT);
+	}
+	/* key releases can be queued ahead of time */
+	if (pos >= MPP_MIDIJOURNAL_DELAY)
+		cutoff = pos - MPP_MIDIJOURNAL_DELAY;
+	dirty = 1;
+	pthread_cond_signal(&cond);
+	pthread_mutex_unlock(&mtx);
+}
+
+/* must be called locked */
+void
+MppMidiJournal :: finish(void)
+{
+	collect();
+
+	pthread_mutex_lock(&mtx);
+	stopping = 1;
+	pthread_cond_signal(&cond);
+	pthread_mutex_unlock(&mtx);
+}
+
+void
+MppMidiJournal :: encode(QByteArray &data)
+{
+	struct umidi20_event *event;
+	uint8_t buf[4];
+	uint32_t delta;
+	uint32_t len;
+	uint32_t n;
+
+	UMIDI20_QUEUE_FOREACH(event, &work->queue) {
+		if (umidi20_event_is_voice(event) == 0)
+			continue;
+		len = MppMidiJournalCmdLen(event->cmd[1]);
+		if (len == 0)
+			continue;
+
+		/* late events are written without delay */
+		if (event->position > lastPosition) {
+			delta = event->position - lastPosition;
+			lastPosition = event->position;
+		} else {
+			delta = 0;
+		}
+		n = MppMidiJournalVarLen(buf, delta);
+		data.append((const char *)buf, n);
+		data.append((const char *)event->cmd + 1, len);
+	}
+
+	/* free the written events */
+	umidi20_event_queue_move(&work->queue, NULL,
+	    0, 0-1, 0, 0-1, UMIDI20_CACHE_INPUT);
+}
+
+/*
+ * Appends the end of track event and patches the track length,
+ * which makes the journal a complete MIDI file.
+ */
+bool
+MppMidiJournal :: finalize(QFile &f, uint32_t len)
+{
+	uint8_t buf[4];
+
+	if (f.seek(MPP_MIDIJOURNAL_HDR + len) == false ||
+	    f.write((const char *)MppMidiJournalEnd,
+	    sizeof(MppMidiJournalEnd)) != sizeof(MppMidiJournalEnd))
+		return (false);
+
+	len += sizeof(MppMidiJournalEnd);
+
+	buf[0] = len >> 24;
+	buf[1] = len >> 16;
+	buf[2] = len >> 8;
+	buf[3] = len;
+
+	if (f.seek(MPP_MIDIJOURNAL_HDR - 4) == false ||
+	    f.write((const char *)buf, 4) != 4 ||
+	    f.flush() == false ||
+	    fsync(f.handle()) != 0)
+		return (false);
+	return (true);
+}
+
+void
+MppMidiJournal :: run(void)
+{
+	QByteArray data;
+	uint8_t done;
+
+	do {
+		pthread_mutex_lock(&mtx);
+		while (dirty == 0 && stopping == 0)
+			pthread_cond_wait(&cond, &mtx);
+		dirty = 0;
+		done = stopping;
+		umidi20_event_queue_move(&pending->queue, &work->queue,
+		    0, done ? 0-1 : cutoff, 0, 0-1, UMIDI20_CACHE_INPUT);
+		pthread_mutex_unlock(&mtx);
+
+		encode(data);
+
+		if (data.size() != 0 && error == MPP_MIDIJOURNAL_OK) {
+			/* each chunk is made durable before the next one */
+			if (file.write(data) != data.size() ||
+			    file.flush() == false ||
+			    fsync(file.handle()) != 0)
+				error = MPP_MIDIJOURNAL_ERR_WRITE;
+			else
+				length += data.size();
+		}
+		data.clear();
+	} while (done == 0);
+
+	if (error == MPP_MIDIJOURNAL_OK && finalize(file, length) == false)
+		error = MPP_MIDIJOURNAL_ERR_WRITE;
+
+	file.close();
+
+	if (error == MPP_MIDIJOURNAL_OK &&
+	    rename(QFile::encodeName(file.fileName()).constData(),
+	    QFile::encodeName(fname).constData()) != 0)
+		error = MPP_MIDIJOURNAL_ERR_WRITE;
+}
+
+/*
+ * Turns the journal of an interrupted recording of "fname" into the
+ * MIDI file "target". A partially written event at the end of the
+ * journal is dropped. Returns true if a journal was recovered.
+ */
+bool
+MppMidiJournal :: recover(const QString &fname, const QString &target)
+{
+	QFile f(journalName(fname));
+	QByteArray data;
+	const uint8_t *ptr;
+	uint32_t size;
+	uint32_t off;
+	uint32_t len;
+	uint32_t n;
+
+	if (f.exists() == false || f.open(QIODevice::ReadWrite) == false)
+		return (false);
+
+	data = f.readAll();
+	ptr = (const uint8_t *)data.constData();
+	size = data.size();
+
+	if (size < MPP_MIDIJOURNAL_HDR ||
+	    memcmp(ptr, MppMidiJournalHeader, MPP_MIDIJOURNAL_HDR - 4) != 0) {
+		f.close();
+		return (false);
+	}
+
+	/* find the end of the last complete event */
+	off = len = MPP_MIDIJOURNAL_HDR;
+	while (off < size) {
+		for (n = 0; n != 3 && off < size && (ptr[off] & 0x80); n++)
+			off++;
+		if (off >= size || (ptr[off] & 0x80))
+			break;
+		off++;
+		if (off >= size)
+			break;
+		n = MppMidiJournalCmdLen(ptr[off]);
+		if (n == 0 || n > size - off)
+			break;
+		off += n;
+		len = off;
+	}
+	data.clear();
+
+	if (f.resize(len) == false ||
+	    finalize(f, len - MPP_MIDIJOURNAL_HDR) == false) {
+		f.close();
+		return (false);
+	}
+	f.close();
+
+	return (rename(QFile::encodeName(f.fileName()).constData(),
+	    QFile::encodeName(target).constData()) == 0);
+}
@@ -0,0 +1,89 @@
+/*-
+ * Copyright (c) 2019 Hans Petter Selasky. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _MIDIPP_MIDIJOURNAL_H_
+#define	_MIDIPP_MIDIJOURNAL_H_
+
+#include "midipp.h"
+
+enum {
+	MPP_MIDIJOURNAL_OK,
+	MPP_MIDIJOURNAL_ERR_MEMORY,
+	MPP_MIDIJOURNAL_ERR_WRITE,
+};
+
+/* events younger than this many milliseconds are not written yet */
+#ifndef MPP_MIDIJOURNAL_DELAY
+#define	MPP_MIDIJOURNAL_DELAY 1000
+#endif
+
+/*
+ * Streaming MIDI file writer for long recording sessions. Recorded
+ * events go into the journal tracks instead of the live song.
+ * collect() hands them over to the writer thread, which appends
+ * them in chunks to a format 0 MIDI file having the ".journal"
+ * suffix. The track length is patched in by finish(), which then
+ * renames the journal into the final file. recover() does the same
+ * for a journal left behind by a crash, writing the file given by
+ * recoveredName() so that a new recording can use the original name.
+ */
+class MppMidiJournal : public QThread {
+public:
+	MppMidiJournal(const QString &);
+	~MppMidiJournal();
+
+	static QString journalName(const QString &);
+	static QString recoveredName(const QString &);
+	static bool recover(const QString &, const QString &);
+
+	bool open(void);
+	uint32_t position(uint32_t);
+	void collect(void);
+	void finish(void);
+
+	QString fname;
+	QFile file;
+	pthread_mutex_t mtx;
+	pthread_cond_t cond;
+	struct umidi20_track *track[MPP_MAX_TRACKS];
+	struct umidi20_track *pending;
+	struct umidi20_track *work;
+	uint32_t startPosition;
+	uint32_t cutoff;
+	uint32_t lastPosition;
+	uint32_t length;
+	uint8_t dirty;
+	uint8_t stopping;
+	int error;
+
+protected:
+	void run();
+
+private:
+	void encode(QByteArray &);
+	static bool finalize(QFile &, uint32_t);
+};
+
+#endif		/* _MIDIPP_MIDIJOURNAL_H_ */
@@ -0,0 +1,200 @@
+/*-
+ * Copyright (c) 2019 Hans Petter Selasky. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "midipp_midiload.h"
+#include "midipp_mainwindow.h"
+
+MppMidiLoad :: MppMidiLoad(const QString &_fname, int _how)
+{
+	fname = _fname;
+	how = _how;
+	song = 0;
+	memset(staging, 0, sizeof(staging));
+	instr = 0;
+	numInstr = 0;
+	maxInstr = 0;
+	error = MPP_MIDILOAD_OK;
+
+	umidi20_mutex_init(&mtx);
+}
+
+MppMidiLoad :: ~MppMidiLoad()
+{
+	for (unsigned x = 0; x != MPP_MAX_TRACKS; x++) {
+		if (staging[x] != 0)
+			umidi20_track_free(staging[x]);
+	}
+	if (song != 0) {
+		pthread_mutex_lock(&mtx);
+		umidi20_song_free(song);
+		pthread_mutex_unlock(&mtx);
+	}
+	free(instr);
+
+	pthread_mutex_destroy(&mtx);
+}
+
+bool
+MppMidiLoad :: instrAdd(struct umidi20_event *event)
+{
+	if (numInstr == maxInstr) {
+		uint32_t max = maxInstr ? (2 * maxInstr) : 64;
+		struct umidi20_event **ptr;
+
+		ptr = (struct umidi20_event **)realloc(instr, max * sizeof(*ptr));
+		if (ptr == NULL)
+			return (false);
+		instr = ptr;
+		maxInstr = max;
+	}
+	instr[numInstr++] = event;
+	return (true);
+}
+
+/* bank and program events, see MppMainWindow::do_instr_check() */
+static bool
+MppMidiLoadIsInstr(struct umidi20_event *event)
+{
+	uint32_t what = umidi20_event_get_what(event);
+
+	if (what & UMIDI20_WHAT_CONTROL_VALUE) {
+		uint8_t addr = umidi20_event_get_control_address(event);
+
+		return (addr == 0x00 || addr == 0x20);
+	}
+	return ((what & UMIDI20_WHAT_PROGRAM_VALUE) != 0);
+}
+
+void
+MppMidiLoad :: run(void)
+{
+	struct umidi20_track *track;
+	struct umidi20_event *event;
+	struct umidi20_event *event_next;
+	MppFileMap map(fname);
+	unsigned int x;
+
+	if (map.valid == false) {
+		error = MPP_MIDILOAD_ERR_READ;
+		return;
+	}
+
+	/* parse directly from the file view */
+	pthread_mutex_lock(&mtx);
+	song = umidi20_load_file(&mtx, map.data, map.size);
+	pthread_mutex_unlock(&mtx);
+
+	if (song == NULL) {
+		error = MPP_MIDILOAD_ERR_PARSE;
+		return;
+	}
+
+	/* release file view early */
+	map.close();
+
+	x = 0;
+	UMIDI20_QUEUE_FOREACH(track, &song->queue) {
+
+	    if (staging[x] == NULL) {
+		staging[x] = umidi20_track_alloc();
+		if (staging[x] == NULL) {
+			error = MPP_MIDILOAD_ERR_MEMORY;
+			return;
+		}
+	    }
+
+	    UMIDI20_QUEUE_FOREACH_SAFE(event, &track->queue, event_next) {
+
+	        if (umidi20_event_is_voice(event) ||
+		    umidi20_event_is_sysex(event)) {
+
+		    if (MppMidiLoadIsInstr(event)) {
+			/* applied by attach() and freed with the song */
+			if (instrAdd(event) == false) {
+				error = MPP_MIDILOAD_ERR_MEMORY;
+				return;
+			}
+			continue;
+		    }
+		} else if (!(umidi20_event_get_what(event) &
+		    (UMIDI20_WHAT_SONG_EVENT | UMIDI20_WHAT_BEAT_EVENT))) {
+			continue;
+		}
+
+		/* move event instead of copying it */
+		UMIDI20_IF_REMOVE(&track->queue, event);
+
+		/* reserve low positions for channel program events */
+		if (event->position < MPP_MIN_POS)
+			event->position = MPP_MIN_POS;
+
+		/* hint for "MidiEventTxCallback()" */
+		event->device_no = MPP_MAGIC_DEVNO + x;
+
+		umidi20_event_queue_insert(&staging[x]->queue,
+		    event, UMIDI20_CACHE_INPUT);
+	    }
+	    if ((how & 2) && ++x == MPP_MAX_TRACKS)
+		break;
+	}
+}
+
+/*
+ * Hands the staging tracks over to the live song. Empty live tracks
+ * are swapped with the staging track. Else the events are moved in
+ * bulk. Must be called with the main lock held.
+ */
+void
+MppMidiLoad :: attach(MppMainWindow *mw)
+{
+	struct umidi20_event *event;
+	bool update = false;
+
+	for (uint32_t n = 0; n != numInstr; n++)
+		mw->do_instr_check(instr[n], NULL);
+
+	for (unsigned x = 0; x != MPP_MAX_TRACKS; x++) {
+		if (staging[x] == NULL)
+			continue;
+
+		UMIDI20_QUEUE_FOREACH(event, &mw->track[x]->queue)
+			break;
+
+		if (event == NULL) {
+			decltype(staging[x]->queue) temp = mw->track[x]->queue;
+			mw->track[x]->queue = staging[x]->queue;
+			staging[x]->queue = temp;
+		} else {
+			umidi20_event_queue_move(&staging[x]->queue,
+			    &mw->track[x]->queue, 0, 0-1, 0, 0-1,
+			    UMIDI20_CACHE_INPUT);
+			update = true;
+		}
+	}
+
+	/* recorded events may lack the device number */
+	if (update)
+		mw->update_play_device_no();
+}
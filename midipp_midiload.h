@@ -0,0 +1,70 @@
+/*-
+ * Copyright (c) 2019 Hans Petter Selasky. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _MIDIPP_MIDILOAD_H_
+#define	_MIDIPP_MIDILOAD_H_
+
+#include "midipp.h"
+
+enum {
+	MPP_MIDILOAD_OK,
+	MPP_MIDILOAD_ERR_READ,
+	MPP_MIDILOAD_ERR_PARSE,
+	MPP_MIDILOAD_ERR_MEMORY,
+};
+
+/*
+ * MIDI file loader. The file is read and parsed into a detached song
+ * on a separate thread without any locks held. The events to keep
+ * are moved into one staging track per destination track. Bank and
+ * program events are collected separately, because the instrument
+ * state may only be updated with the main lock held. attach() then
+ * hands the staging tracks over to the live song.
+ */
+class MppMidiLoad : public QThread {
+public:
+	MppMidiLoad(const QString &, int);
+	~MppMidiLoad();
+
+	void attach(MppMainWindow *);
+
+	QString fname;
+	pthread_mutex_t mtx;
+	struct umidi20_song *song;
+	struct umidi20_track *staging[MPP_MAX_TRACKS];
+	struct umidi20_event **instr;
+	uint32_t numInstr;
+	uint32_t maxInstr;
+	int how;
+	int error;
+
+protected:
+	void run();
+
+private:
+	bool instrAdd(struct umidi20_event *);
+};
+
+#endif		/* _MIDIPP_MIDILOAD_H_ */
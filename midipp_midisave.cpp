@@ -0,0 +1,120 @@
+/*-
+ * Copyright (c) 2019 Hans Petter Selasky. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <QSaveFile>
+
+#include "midipp_midisave.h"
+#include "midipp_mainwindow.h"
+
+MppMidiSave :: MppMidiSave(const QString &_fname)
+{
+	fname = _fname;
+	song = 0;
+	memset(track, 0, sizeof(track));
+	error = MPP_MIDISAVE_OK;
+
+	umidi20_mutex_init(&mtx);
+}
+
+MppMidiSave :: ~MppMidiSave()
+{
+	if (song != 0) {
+		/* the tracks are freed with the song */
+		pthread_mutex_lock(&mtx);
+		umidi20_song_free(song);
+		pthread_mutex_unlock(&mtx);
+	}
+	pthread_mutex_destroy(&mtx);
+}
+
+/* must be called locked */
+void
+MppMidiSave :: snapshot(MppMainWindow *mw)
+{
+	struct umidi20_event *event;
+	struct umidi20_event *event_copy;
+	unsigned n;
+
+	pthread_mutex_lock(&mtx);
+
+	song = umidi20_song_alloc(&mtx, mw->song->midi_file_format,
+	    mw->song->midi_resolution, mw->song->midi_division_type);
+	if (song == 0)
+		goto error;
+
+	for (n = 0; n != MPP_MAX_TRACKS; n++) {
+		track[n] = umidi20_track_alloc();
+		if (track[n] == 0)
+			goto error;
+		umidi20_song_track_add(song, NULL, track[n], 0);
+
+		UMIDI20_QUEUE_FOREACH(event, &mw->track[n]->queue) {
+			event_copy = umidi20_event_copy(event, 0);
+			if (event_copy == 0)
+				goto error;
+			umidi20_event_queue_insert(&track[n]->queue,
+			    event_copy, UMIDI20_CACHE_INPUT);
+		}
+	}
+
+	mw->handle_midi_file_instr_prepend(track);
+
+	pthread_mutex_unlock(&mtx);
+	return;
+
+error:
+	error = MPP_MIDISAVE_ERR_MEMORY;
+	pthread_mutex_unlock(&mtx);
+}
+
+void
+MppMidiSave :: run(void)
+{
+	uint8_t *data;
+	uint32_t len;
+	uint8_t status;
+
+	if (error != MPP_MIDISAVE_OK)
+		return;
+
+	pthread_mutex_lock(&mtx);
+	status = umidi20_save_file(song, &data, &len);
+	pthread_mutex_unlock(&mtx);
+
+	if (status != 0) {
+		error = MPP_MIDISAVE_ERR_ENCODE;
+		return;
+	}
+
+	/* the new file replaces the old one on commit only */
+	QSaveFile file(fname);
+
+	if (file.open(QIODevice::WriteOnly) == false ||
+	    file.write((const char *)data, len) != (qint64)len ||
+	    file.commit() == false)
+		error = MPP_MIDISAVE_ERR_WRITE;
+
+	free(data);
+}
@@ -0,0 +1,61 @@
+/*-
+ * Copyright (c) 2019 Hans Petter Selasky. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _MIDIPP_MIDISAVE_H_
+#define	_MIDIPP_MIDISAVE_H_
+
+#include "midipp.h"
+
+enum {
+	MPP_MIDISAVE_OK,
+	MPP_MIDISAVE_ERR_MEMORY,
+	MPP_MIDISAVE_ERR_ENCODE,
+	MPP_MIDISAVE_ERR_WRITE,
+};
+
+/*
+ * MIDI file writer. snapshot() copies the tracks of the live song
+ * into a detached song while the main lock is held. The detached
+ * song is encoded and written on a separate thread. The file is
+ * replaced atomically, so that a failed write keeps the old file.
+ */
+class MppMidiSave : public QThread {
+public:
+	MppMidiSave(const QString &);
+	~MppMidiSave();
+
+	void snapshot(MppMainWindow *);
+
+	QString fname;
+	pthread_mutex_t mtx;
+	struct umidi20_song *song;
+	struct umidi20_track *track[MPP_MAX_TRACKS];
+	int error;
+
+protected:
+	void run();
+};
+
+#endif		/* _MIDIPP_MIDISAVE_H_ */
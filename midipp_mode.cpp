@@ -129,7 +129,7 @@ MppMode :: MppMode(MppScoreMain *_parent, uint8_t _vi)
 	spn_aux_treb_chan = new MppChanSel(sm->mainWindow, -1, MPP_CHAN_NONE);
 	connect(spn_aux_treb_chan, SIGNAL(valueChanged(int)), this, SLOT(handle_changed()));
 	
-	but_note_mode = new MppButtonMap("Output note mode\0" "Normal\0" "SysEx\0", 2, 2);
+	but_note_mode = new MppButtonMap("Output note mode\0" "Normal\0" "SysEx\0" "MPE\0", 3, 3);
 	connect(but_note_mode, SIGNAL(selectionChanged(int)), this, SLOT(handle_changed()));
 
 	gl->addWidget(gb_iconfig, 0, 0, 2, 2);
@@ -458,6 +458,7 @@ MppMode :: handle_changed()
 	int volumeTreb;
 	int key_mode;
 	int note_mode;
+	int note_mode_old;
 	int chord_contrast;
 	int chord_norm;
 	int song_events;
@@ -486,6 +487,7 @@ MppMode :: handle_changed()
 	if (key_mode < 0 || key_mode >= MM_PASS_MAX)
 		key_mode = 0;
 
+	sm->atomicLock();
 	sm->mainWindow->atomic_lock();
 	sm->baseKey = base_key;
 	sm->delayNoise = key_delay;
@@ -506,8 +508,16 @@ MppMode :: handle_changed()
 	sm->chordContrast = chord_contrast;
 	sm->chordNormalize = chord_norm;
 	sm->songEventsOn = song_events;
+	note_mode_old = sm->noteMode;
 	sm->noteMode = note_mode;
+	sm->mainWindow->tx_route_update_locked();
+	sm->mainWindow->rx_route_update_locked();
 	sm->mainWindow->atomic_unlock();
+	sm->atomicUnlock();
+
+	/* send the MPE configuration, if enabled */
+	if (note_mode == MM_NOTEMODE_MPE && note_mode_old != note_mode)
+		sm->mainWindow->handle_config_local_keys();
 
 	sanity_check();
 }
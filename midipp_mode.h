@@ -31,6 +31,7 @@
 enum {
 	MM_NOTEMODE_NORMAL,
 	MM_NOTEMODE_SYSEX,
+	MM_NOTEMODE_MPE,
 	MM_NOTEMODE_MAX,
 };
 
@@ -29,6 +29,8 @@
 #include "midipp_checkbox.h"
 #include "midipp_buttonmap.h"
 
+static const uint8_t MppCoalesceWindow[] = { 0, 2, 5, 10, 20 };
+
 MppMuteMap :: MppMuteMap(QWidget *parent, MppMainWindow *_mw, int _devno)
   : QDialog(parent)
 {
@@ -101,6 +103,12 @@ MppMuteMap :: MppMuteMap(QWidget *parent, MppMainWindow *_mw, int _devno)
 	gb_other->addWidget(cbx_mute_non_channel, 2, 0, 1, 1);
 	gb_other->addWidget(cbx_mute_control, 2, 1, 1, 1);
 
+	cbx_coalesce = new MppButtonMap("Rate limit MIDI control and pitch bend events\0"
+	    "OFF\0" "2ms\0" "5ms\0" "10ms\0" "20ms\0", 5, 5);
+	connect(cbx_coalesce, SIGNAL(selectionChanged(int)), this, SLOT(handle_apply_all()));
+
+	gb_other->addWidget(cbx_coalesce, 3, 0, 1, 2);
+
 	handle_revert_all();
 }
 
@@ -116,6 +124,7 @@ MppMuteMap :: handle_reset_all()
 	MPP_BLOCKED(cbx_mute_non_channel,setSelection(0));
 	MPP_BLOCKED(cbx_mute_local_keys,setSelection(0));
 	MPP_BLOCKED(cbx_mute_control,setSelection(0));
+	MPP_BLOCKED(cbx_coalesce,setSelection(0));
 
 	handle_apply_all();
 }
@@ -129,6 +138,7 @@ MppMuteMap :: handle_revert_all()
 	uint8_t mute_local_keys_copy;
 	uint8_t mute_midi_non_channel_copy;
 	uint8_t mute_control_copy;
+	uint8_t coalesce_copy;
 
 	mw->atomic_lock();
 	for (uint8_t n = 0; n != 16; n++)
@@ -144,6 +154,7 @@ MppMuteMap :: handle_revert_all()
 		mute_local_keys_copy = 0;
 	mute_midi_non_channel_copy = mw->muteAllNonChannel[devno];
 	mute_control_copy = mw->muteAllControl[devno];
+	coalesce_copy = mw->txCoalesceWindow[devno];
 	mw->atomic_unlock();
 
 	for (uint8_t n = 0; n != 16; n++)
@@ -154,6 +165,13 @@ MppMuteMap :: handle_revert_all()
 	MPP_BLOCKED(cbx_mute_local_keys,setSelection(mute_local_keys_copy));
 	MPP_BLOCKED(cbx_mute_non_channel,setSelection(mute_midi_non_channel_copy));
 	MPP_BLOCKED(cbx_mute_control,setSelection(mute_control_copy));
+
+	for (uint8_t n = 0; n != sizeof(MppCoalesceWindow); n++) {
+		if (MppCoalesceWindow[n] == coalesce_copy) {
+			MPP_BLOCKED(cbx_coalesce,setSelection(n));
+			break;
+		}
+	}
 }
 
 void
@@ -166,6 +184,7 @@ MppMuteMap :: handle_apply_all()
 	uint8_t mute_local_disable_copy;
 	uint8_t mute_midi_non_channel_copy;
 	uint8_t mute_control_copy;
+	uint8_t coalesce_copy;
 	bool apply = false;
 
 	for (uint8_t n = 0; n != 16; n++)
@@ -177,6 +196,7 @@ MppMuteMap :: handle_apply_all()
 	mute_local_disable_copy = (cbx_mute_local_keys->currSelection == 2);
 	mute_midi_non_channel_copy = (cbx_mute_non_channel->currSelection != 0);
 	mute_control_copy = (cbx_mute_control->currSelection != 0);
+	coalesce_copy = MppCoalesceWindow[cbx_coalesce->currSelection];
 
 	mw->atomic_lock();
 	for (uint8_t n = 0; n != 16; n++)
@@ -190,6 +210,8 @@ MppMuteMap :: handle_apply_all()
 	mw->disableLocalKeys[devno] = mute_local_disable_copy;
 	mw->muteAllNonChannel[devno] = mute_midi_non_channel_copy;
 	mw->muteAllControl[devno] = mute_control_copy;
+	__atomic_store_n(&mw->txCoalesceWindow[devno], coalesce_copy, __ATOMIC_RELAXED);
+	mw->tx_route_update_locked();
 	mw->atomic_unlock();
 
 	if (apply)
@@ -50,6 +50,7 @@ public:
 	MppButtonMap *cbx_mute_local_keys;
 	MppButtonMap *cbx_mute_control;
 	MppButtonMap *cbx_mute_non_channel;
+	MppButtonMap *cbx_coalesce;
 
 	QPushButton *but_reset_all;
 	QPushButton *but_close_all;
@@ -0,0 +1,109 @@
+/*-
+ * Copyright (c) 2019 Hans Petter Selasky. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "midipp_pressed.h"
+
+static uint32_t
+MppPressedHash(uint64_t id)
+{
+	return (((uint32_t)(id >> 32) * 0x9E3779B1U) ^
+	    (uint32_t)(id >> 16)) % MPP_PRESSED_HASH;
+}
+
+void
+MppPressed :: clear(void)
+{
+	memset(hash, 0, sizeof(hash));
+	count = 0;
+	frozen = 0;
+}
+
+/*
+ * Returns the index of the first non-frozen entry matching the
+ * given key and channel, starting at the given position in the hash
+ * chain, else -1. Pass the returned index plus one to continue.
+ */
+int
+MppPressed :: find(uint64_t value, uint32_t start)
+{
+	const uint64_t id = MPP_PRESSED_ID(value);
+	uint16_t n;
+
+	n = start ? next[start - 1] : hash[MppPressedHash(id)];
+
+	for (; n != 0; n = next[n - 1]) {
+		if (n <= frozen)
+			continue;
+		if (MPP_PRESSED_ID(entry[n - 1]) == id)
+			return (n - 1);
+	}
+	return (-1);
+}
+
+bool
+MppPressed :: insert(uint64_t value)
+{
+	uint32_t h;
+
+	if (count == MPP_PRESSED_MAX)
+		return (false);
+
+	h = MppPressedHash(MPP_PRESSED_ID(value));
+
+	entry[count] = value;
+	next[count] = hash[h];
+	hash[h] = ++count;
+	return (true);
+}
+
+/*
+ * Removes the entry at the given index. The last entry is moved
+ * into its place, so callers iterating must go backwards.
+ */
+void
+MppPressed :: remove(uint32_t index)
+{
+	uint16_t *pn;
+	uint32_t last;
+
+	/* unlink entry */
+	for (pn = &hash[MppPressedHash(MPP_PRESSED_ID(entry[index]))];
+	    *pn != index + 1; pn = &next[*pn - 1])
+		;
+	*pn = next[index];
+
+	last = --count;
+	if (index == last)
+		return;
+
+	/* relink last entry at the new index */
+	for (pn = &hash[MppPressedHash(MPP_PRESSED_ID(entry[last]))];
+	    *pn != last + 1; pn = &next[*pn - 1])
+		;
+	*pn = index + 1;
+
+	entry[index] = entry[last];
+	next[index] = next[last];
+}
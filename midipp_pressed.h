@@ -0,0 +1,62 @@
+/*-
+ * Copyright (c) 2019 Hans Petter Selasky. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _MIDIPP_PRESSED_H_
+#define	_MIDIPP_PRESSED_H_
+
+#include "midipp.h"
+
+#if (MPP_PRESSED_MAX < 1) || (MPP_PRESSED_MAX > 65535)
+#error "MPP_PRESSED_MAX must be in the range 1..65535"
+#endif
+
+#define	MPP_PRESSED_HASH	(2 * MPP_PRESSED_MAX)
+#define	MPP_PRESSED_ID(x)	((x) & 0xFFFFFFFF00FF0000ULL)
+
+/*
+ * Set of pressed keys. Each entry is a packed 64-bit value holding
+ * the duration, channel, delay and output key, see setPressedKey().
+ * Keys are kept in a dense array and indexed by key and channel.
+ * The first "frozen" entries are hidden from lookups while a macro
+ * is playing. All-zero is a valid empty set.
+ */
+class MppPressed {
+public:
+	void clear(void);
+	void freeze(void) { frozen = count; };
+	void thaw(void) { frozen = 0; };
+
+	int find(uint64_t, uint32_t = 0);
+	bool insert(uint64_t);
+	void remove(uint32_t);
+
+	uint64_t entry[MPP_PRESSED_MAX];
+	uint16_t next[MPP_PRESSED_MAX];
+	uint16_t hash[MPP_PRESSED_HASH];
+	uint32_t count;
+	uint32_t frozen;
+};
+
+#endif		/* _MIDIPP_PRESSED_H_ */
@@ -0,0 +1,299 @@
+/*-
+ * Copyright (c) 2019 Hans Petter Selasky. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "midipp_record.h"
+
+static uint32_t
+MppRecordQuant(uint32_t value, uint32_t grid)
+{
+	return (((value + (grid / 2)) / grid) * grid);
+}
+
+MppRecord :: MppRecord()
+{
+	input = 0;
+	numInput = 0;
+	maxInput = 0;
+	dropped = 0;
+	batch = 0;
+	numBatch = 0;
+	maxBatch = 0;
+	notes = 0;
+	numNotes = 0;
+	maxNotes = 0;
+	chords = 0;
+	maxChords = 0;
+	lastPosition = 0;
+
+	reset();
+}
+
+MppRecord :: ~MppRecord()
+{
+	free(input);
+	free(batch);
+	free(notes);
+	free(chords);
+}
+
+/* must be called locked */
+void
+MppRecord :: add(uint32_t pos, uint8_t key, uint8_t press)
+{
+	struct MppRecordEvent *ptr;
+	uint32_t max;
+
+	if (numInput == maxInput) {
+		max = maxInput ? 2 * maxInput : 256;
+		ptr = (struct MppRecordEvent *)
+		    realloc(input, max * sizeof(input[0]));
+		if (ptr == 0) {
+			__atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+			return;
+		}
+		input = ptr;
+		maxInput = max;
+	}
+	input[numInput].position = pos;
+	input[numInput].key = key & 0x7F;
+	input[numInput].press = press;
+	numInput++;
+}
+
+/* must be called locked */
+void
+MppRecord :: swap(void)
+{
+	struct MppRecordEvent *ptr;
+	uint32_t max;
+
+	/* the batch is empty, because process() consumed it */
+	ptr = batch;
+	max = maxBatch;
+
+	batch = input;
+	numBatch = numInput;
+	maxBatch = maxInput;
+
+	input = ptr;
+	numInput = 0;
+	maxInput = max;
+}
+
+/* must be called locked */
+void
+MppRecord :: reset(void)
+{
+	numInput = 0;
+	numBatch = 0;
+	numNotes = 0;
+	numHeld = 0;
+
+	for (unsigned x = 0; x != 128; x++)
+		held[x] = -1;
+}
+
+bool
+MppRecord :: noteAdd(uint32_t pos, uint8_t key)
+{
+	struct MppRecordNote *ptr;
+	uint32_t max;
+
+	if (numNotes == maxNotes) {
+		max = maxNotes ? 2 * maxNotes : 256;
+		ptr = (struct MppRecordNote *)
+		    realloc(notes, max * sizeof(notes[0]));
+		if (ptr == 0)
+			return (false);
+		notes = ptr;
+		maxNotes = max;
+	}
+	notes[numNotes].start = pos;
+	notes[numNotes].end = pos;
+	notes[numNotes].key = key;
+	notes[numNotes].released = 0;
+	numNotes++;
+	return (true);
+}
+
+void
+MppRecord :: output(QString &out, uint32_t c, uint32_t numChords, uint32_t grid)
+{
+	uint32_t first = chords[c];
+	uint32_t last = (c + 1 < numChords) ? chords[c + 1] : numNotes;
+	uint32_t start = notes[first].start;
+	uint32_t end = start;
+	uint32_t next;
+	uint32_t total;
+	uint32_t rest;
+	uint32_t last_u = 0;
+	uint32_t u;
+	uint32_t k;
+	char buf[32];
+
+	for (uint32_t x = first; x != last; x++) {
+		if (notes[x].end > end)
+			end = notes[x].end;
+	}
+
+	/* the last line lasts as long as its notes */
+	if (c + 1 < numChords)
+		next = notes[chords[c + 1]].start;
+	else
+		next = end;
+
+	total = MppRecordQuant(next - start, grid);
+	if (total < grid)
+		total = grid;
+
+	if (next > end)
+		rest = MppRecordQuant(next - end, grid);
+	else
+		rest = 0;
+	if (rest > total - grid)
+		rest = total - grid;
+
+	for (uint32_t x = first; x != last; x++) {
+		/* count the lines until the key is released */
+		for (u = 1, k = c + 1; k < numChords &&
+		    u != MPP_MAX_DURATION; k++, u++) {
+			if (notes[chords[k]].start + (grid / 2) > notes[x].end)
+				break;
+		}
+		if (u != last_u) {
+			last_u = u;
+			snprintf(buf, sizeof(buf), "U%u ", u);
+			out += buf;
+		}
+		out += mid_key_str[notes[x].key];
+		out += ' ';
+	}
+
+	snprintf(buf, sizeof(buf), "W%u.%u\n", total - rest, rest);
+	out += buf;
+}
+
+/*
+ * Turns the collected events into score lines. Keys pressed within
+ * "window" milliseconds of the first key of a chord belong to that
+ * chord. A line is complete when all its keys are released before
+ * the start of the last known chord, so that the number of lines
+ * covered by each key is known. After MPP_RECORD_IDLE milliseconds
+ * without any keys pressed, all lines are complete. Returns true if
+ * any lines were output.
+ */
+bool
+MppRecord :: process(QString &out, uint32_t now, uint32_t window, uint32_t bpm)
+{
+	struct MppRecordEvent *pe;
+	uint32_t *ptr;
+	uint32_t numChords;
+	uint32_t grid;
+	uint32_t end;
+	uint32_t c;
+	uint32_t x;
+	uint32_t y;
+	int32_t n;
+
+	for (x = 0; x != numBatch; x++) {
+		pe = batch + x;
+		n = held[pe->key];
+		if (n >= 0) {
+			notes[n].end = pe->position;
+			notes[n].released = 1;
+			held[pe->key] = -1;
+			numHeld--;
+		}
+		if (pe->press) {
+			if (noteAdd(pe->position, pe->key)) {
+				held[pe->key] = numNotes - 1;
+				numHeld++;
+			} else {
+				__atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+			}
+		}
+		lastPosition = pe->position;
+	}
+	numBatch = 0;
+
+	if (numNotes == 0)
+		return (false);
+
+	if (maxChords < numNotes) {
+		ptr = (uint32_t *)realloc(chords, maxNotes * sizeof(chords[0]));
+		if (ptr == 0)
+			return (false);
+		chords = ptr;
+		maxChords = maxNotes;
+	}
+
+	/* group the notes into chords */
+	numChords = 0;
+	for (x = 0; x != numNotes; x++) {
+		if (numChords == 0 ||
+		    notes[x].start - notes[chords[numChords - 1]].start > window)
+			chords[numChords++] = x;
+	}
+
+	/* sixteenth notes */
+	grid = bpm ? (60000 / 4) / bpm : 0;
+	if (grid == 0)
+		grid = 1;
+
+	/* find the complete lines */
+	if (numHeld == 0 && (now - lastPosition) >= MPP_RECORD_IDLE) {
+		c = numChords;
+	} else {
+		for (c = 0; c + 1 < numChords; c++) {
+			end = 0;
+			for (x = chords[c]; x != chords[c + 1]; x++) {
+				if (notes[x].released == 0)
+					break;
+				if (notes[x].end > end)
+					end = notes[x].end;
+			}
+			if (x != chords[c + 1] ||
+			    end > notes[chords[numChords - 1]].start)
+				break;
+		}
+	}
+
+	if (c == 0)
+		return (false);
+
+	for (x = 0; x != c; x++)
+		output(out, x, numChords, grid);
+
+	/* drop the notes of the output lines */
+	y = (c == numChords) ? numNotes : chords[c];
+	memmove(notes, notes + y, (numNotes - y) * sizeof(notes[0]));
+	numNotes -= y;
+
+	for (x = 0; x != 128; x++) {
+		if (held[x] >= 0)
+			held[x] -= y;
+	}
+	return (true);
+}
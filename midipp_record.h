@@ -0,0 +1,90 @@
+/*-
+ * Copyright (c) 2019 Hans Petter Selasky. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _MIDIPP_RECORD_H_
+#define	_MIDIPP_RECORD_H_
+
+#include "midipp.h"
+
+/* silence which completes a score recording */
+#define	MPP_RECORD_IDLE 1000	/* ms */
+
+struct MppRecordEvent {
+	uint32_t position;
+	uint8_t key;
+	uint8_t press;
+};
+
+struct MppRecordNote {
+	uint32_t start;
+	uint32_t end;
+	uint8_t key;
+	uint8_t released;
+};
+
+/*
+ * Record to score engine. Key presses and releases are time stamped
+ * and collected by add() with the main lock held. swap() hands the
+ * collected events over to the GUI thread in constant time. process()
+ * groups the notes into chords, one per score line. The note
+ * durations become "U" values and the time until the next chord
+ * becomes a "W" timer, both quantized to sixteenth notes of the
+ * current BPM. Only complete lines are output.
+ */
+class MppRecord {
+public:
+	MppRecord();
+	~MppRecord();
+
+	void add(uint32_t, uint8_t, uint8_t);
+	void swap(void);
+	void reset(void);
+	bool process(QString &, uint32_t, uint32_t, uint32_t);
+
+	/* producer side, protected by the main lock */
+	struct MppRecordEvent *input;
+	uint32_t numInput;
+	uint32_t maxInput;
+	uint32_t dropped;
+
+	/* consumer side, only used by the GUI thread */
+	struct MppRecordEvent *batch;
+	uint32_t numBatch;
+	uint32_t maxBatch;
+	struct MppRecordNote *notes;
+	uint32_t numNotes;
+	uint32_t maxNotes;
+	uint32_t *chords;
+	uint32_t maxChords;
+	int32_t held[128];
+	uint32_t numHeld;
+	uint32_t lastPosition;
+
+private:
+	bool noteAdd(uint32_t, uint8_t);
+	void output(QString &, uint32_t, uint32_t, uint32_t);
+};
+
+#endif		/* _MIDIPP_RECORD_H_ */
@@ -139,10 +139,12 @@ MppReplayTab :: handleStartRecordSomething()
 	handleEraseMidiTracks();
 
 	if (saved_mode < 0) {
+		mainWindow->scores_main[0]->atomicLock();
 		mainWindow->atomic_lock();
 		saved_mode = mainWindow->scores_main[0]->keyMode;
 		mainWindow->scores_main[0]->keyMode = MM_PASS_ALL;
 		mainWindow->atomic_unlock();
+		mainWindow->scores_main[0]->atomicUnlock();
 
 		mainWindow->handle_mode(0, 0);
 	}
@@ -157,9 +159,11 @@ MppReplayTab :: handleRestoreMode()
 	if (saved_mode < 0)
 		return;
 
+	mainWindow->scores_main[0]->atomicLock();
 	mainWindow->atomic_lock();
 	mainWindow->scores_main[0]->keyMode = saved_mode;
 	mainWindow->atomic_unlock();
+	mainWindow->scores_main[0]->atomicUnlock();
 
 	mainWindow->handle_mode(0, 0);
 
@@ -258,11 +262,13 @@ MppReplayTab :: handleCheckMode()
 {
 	bool change;
 
+	mainWindow->scores_main[0]->atomicLock();
 	mainWindow->atomic_lock();
 	change = (mainWindow->scores_main[0]->keyMode == MM_PASS_ALL);
 	if (change)
 		mainWindow->scores_main[0]->keyMode = MM_PASS_NONE_FIXED;
 	mainWindow->atomic_unlock();
+	mainWindow->scores_main[0]->atomicUnlock();
 
 	if (change)
 		mainWindow->handle_mode(0, 0);
@@ -0,0 +1,93 @@
+/*-
+ * Copyright (c) 2019 Hans Petter Selasky. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "midipp_ring.h"
+
+MppRing :: MppRing(uint32_t size)
+{
+	uint32_t temp;
+
+	/* round up to nearest power of two */
+	for (temp = 1; temp < size; temp *= 2)
+		;
+
+	data = new uint32_t [temp];
+	mask = temp - 1;
+	head = 0;
+	tail = 0;
+	overflow = 0;
+}
+
+MppRing :: ~MppRing()
+{
+	delete [] data;
+}
+
+/* must only be called by the producer */
+bool
+MppRing :: push(uint32_t value)
+{
+	uint32_t h = __atomic_load_n(&head, __ATOMIC_RELAXED);
+	uint32_t t = __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+
+	if ((h - t) > mask) {
+		__atomic_fetch_add(&overflow, 1, __ATOMIC_RELAXED);
+		return (false);
+	}
+
+	data[h & mask] = value;
+
+	__atomic_store_n(&head, h + 1, __ATOMIC_RELEASE);
+	return (true);
+}
+
+/* must only be called by the consumer */
+bool
+MppRing :: pop(uint32_t *pvalue)
+{
+	uint32_t t = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+	uint32_t h = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+
+	if (h == t)
+		return (false);
+
+	*pvalue = data[t & mask];
+
+	__atomic_store_n(&tail, t + 1, __ATOMIC_RELEASE);
+	return (true);
+}
+
+uint32_t
+MppRing :: level(void)
+{
+	return (__atomic_load_n(&head, __ATOMIC_ACQUIRE) -
+	    __atomic_load_n(&tail, __ATOMIC_ACQUIRE));
+}
+
+uint32_t
+MppRing :: overflows(void)
+{
+	return (__atomic_load_n(&overflow, __ATOMIC_RELAXED));
+}
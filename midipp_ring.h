@@ -0,0 +1,58 @@
+/*-
+ * Copyright (c) 2019 Hans Petter Selasky. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _MIDIPP_RING_H_
+#define	_MIDIPP_RING_H_
+
+#include "midipp.h"
+
+#if (MPP_MAX_QUEUE < 2) || (MPP_MAX_QUEUE & (MPP_MAX_QUEUE - 1))
+#error "MPP_MAX_QUEUE must be a power of two"
+#endif
+
+/*
+ * Bounded lock-free ring buffer for a single producer and a single
+ * consumer. The producer side must be serialized by the caller.
+ */
+class MppRing {
+public:
+	MppRing(uint32_t size);
+	~MppRing();
+
+	bool push(uint32_t);
+	bool pop(uint32_t *);
+	uint32_t level(void);
+	uint32_t overflows(void);
+
+	uint32_t *data;
+	uint32_t mask;
+
+	uint32_t head __attribute__((__aligned__(64)));	/* producer */
+	uint32_t overflow;
+
+	uint32_t tail __attribute__((__aligned__(64)));	/* consumer */
+};
+
+#endif		/* _MIDIPP_RING_H_ */
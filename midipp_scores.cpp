@@ -198,6 +198,8 @@ MppScoreMain :: MppScoreMain(MppMainWindow *parent, int _unit)
 	synthDeviceTreb = -1;
 	unit = _unit;
 
+	lock = new MppLock(MPP_LOCK_VIEW(_unit), "view");
+
 	/* Set parent */
 
 	mainWindow = parent;
@@ -331,6 +333,8 @@ MppScoreMain :: MppScoreMain(MppMainWindow *parent, int _unit)
 MppScoreMain :: ~MppScoreMain()
 {
 	handleScoreFileNew();
+
+	delete lock;
 }
 
 void
@@ -625,11 +629,14 @@ MppScoreMain :: viewMousePressEvent(QMouseEvent *e)
 
 	mainWindow->handle_tab_changed(1);
 
+	/* stopping releases keys in all views */
+	mainWindow->atomic_lock_views();
 	mainWindow->atomic_lock();
 	head.jumpPointer(pVisual[yi].start);
 	head.syncLast();
 	mainWindow->handle_stop();
 	mainWindow->atomic_unlock();
+	mainWindow->atomic_unlock_views();
 }
 
 void
@@ -690,6 +697,7 @@ void
 MppScoreMain :: viewPaintEvent(QPaintEvent *event)
 {
 	QPainter paint(viewWidgetSub);
+	struct MppPlayState ps;
 	MppVisualDot *pcdot;
 	MppVisualDot *podot;
 	MppElement *curr;
@@ -710,11 +718,10 @@ MppScoreMain :: viewPaintEvent(QPaintEvent *event)
 
 	paint.fillRect(event->rect(), Mpp.ColorWhite);
 
-	mainWindow->atomic_lock();
-	curr = head.state.curr_start;
-	last = head.state.last_start;
+	getPlayState(&ps);
+	curr = ps.curr_start;
+	last = ps.last_start;
 	scroll = picScroll;
-	mainWindow->atomic_unlock();
 
 	y_blocks = (viewWidgetSub->height() / visual_y_max);
 	if (y_blocks == 0)
@@ -815,7 +822,11 @@ MppScoreMain :: viewPaintEvent(QPaintEvent *event)
 	}
 }
 
-/* The following function must be called locked */
+/*
+ * The following function must be called unlocked. The score is
+ * parsed into a temporary head which is swapped in under the view
+ * lock, so that key events on other views are not delayed.
+ */
 
 void
 MppScoreMain :: handleParse(const QString &pstr)
@@ -823,6 +834,9 @@ MppScoreMain :: handleParse(const QString &pstr)
 	MppElement *start;
 	MppElement *stop;
 	MppElement *ptr;
+	MppHead temp;
+	uint32_t channels;
+	int bpm_ref[2] = { -1, -1 };
 	int key_mode;
 	int auto_melody;
 	int auto_utune;
@@ -831,17 +845,14 @@ MppScoreMain :: handleParse(const QString &pstr)
 	int x;
 	int num_dot;
 
-	/* reset head structure */
-	head.clear();
-
 	/* add string to input */
-	head += pstr;
+	temp += pstr;
 
 	/* flush last element, if any */
-	head.flush();
+	temp.flush();
 
 	/* set initial mask for active channels */
-	active_channels = 1;
+	channels = 1;
 
 	/* no automatic melody */
 	auto_melody = 0;
@@ -865,7 +876,7 @@ MppScoreMain :: handleParse(const QString &pstr)
 	free(pVisual);
 	pVisual = 0;
 
-	for (start = stop = 0; head.foreachLine(&start, &stop); ) {
+	for (start = stop = 0; temp.foreachLine(&start, &stop); ) {
 
 		has_string = 0;
 
@@ -874,12 +885,9 @@ MppScoreMain :: handleParse(const QString &pstr)
 			if (ptr->type == MPP_T_COMMAND) {
 				switch (ptr->value[0]) {
 				case MPP_CMD_BPM_REF:
-					/* update BPM timer */
-					mainWindow->atomic_lock();
-					mainWindow->dlg_bpm->period_ref = ptr->value[1];
-					mainWindow->dlg_bpm->period_cur = ptr->value[2];
-					mainWindow->dlg_bpm->handle_update();
-					mainWindow->atomic_unlock();
+					/* update BPM timer, last one wins */
+					bpm_ref[0] = ptr->value[1];
+					bpm_ref[1] = ptr->value[2];
 					break;
 				case MPP_CMD_AUTO_MELODY:
 					auto_melody = ptr->value[1];
@@ -895,7 +903,7 @@ MppScoreMain :: handleParse(const QString &pstr)
 				}
 			} else if (ptr->type == MPP_T_CHANNEL) {
 				if (ptr->value[0] > -1 && ptr->value[0] < 16)
-					active_channels |= (1 << ptr->value[0]);
+					channels |= (1 << ptr->value[0]);
 			} else if (ptr->type == MPP_T_STRING_DESC || 
 			    ptr->type == MPP_T_STRING_DOT ||
 			    ptr->type == MPP_T_STRING_CHORD) {
@@ -919,11 +927,11 @@ MppScoreMain :: handleParse(const QString &pstr)
 		memset(pVisual, 0, size);
 	}
 
-	head.dotReorder();
+	temp.dotReorder();
 
 	index = 0;
 
-	for (start = stop = 0; head.foreachLine(&start, &stop); ) {
+	for (start = stop = 0; temp.foreachLine(&start, &stop); ) {
 
 		has_string = 0;
 		num_dot = 0;
@@ -963,15 +971,34 @@ MppScoreMain :: handleParse(const QString &pstr)
 	}
 	/* extend region of first and last visual */
 	if (visual_max != 0) {
-		pVisual[0].start = TAILQ_FIRST(&head.head);
+		pVisual[0].start = TAILQ_FIRST(&temp.head);
 		pVisual[visual_max - 1].stop = 0;
 	}
 
 	/* compile before auto-melody */
-	sheet->compile(head);
+	sheet->compile(temp);
 	
 	if (auto_utune > 0)
-		head.tuneScore();
+		temp.tuneScore();
+
+	/* number all elements to make searching easier */
+	temp.sequence();
+
+	atomicLock();
+	mainWindow->atomic_lock();
+
+	/* swap in the new score, element pointers stay valid */
+	head.clear();
+	TAILQ_CONCAT(&head.head, &temp.head, entry);
+	head.reset();
+
+	active_channels = channels;
+
+	if (bpm_ref[0] > -1) {
+		mainWindow->dlg_bpm->period_ref = bpm_ref[0];
+		mainWindow->dlg_bpm->period_cur = bpm_ref[1];
+		mainWindow->dlg_bpm->handle_update();
+	}
 
 	/* check if key-mode should be applied */
 	switch (key_mode) {
@@ -1003,15 +1030,15 @@ MppScoreMain :: handleParse(const QString &pstr)
 		break;
 	}
 
-	/* number all elements to make searching easier */
-	head.sequence();
-
 	/* get first line */
 	head.currLine(&start, &stop);
 
 	/* sync last */
 	head.syncLast();
 
+	mainWindow->atomic_unlock();
+	atomicUnlock();
+
 	/* create the graphics */
 	handlePrintSub(0, QPoint(0,0));
 
@@ -1155,7 +1182,7 @@ MppScoreMain :: handleLabelJump(int pos)
 	head.jumpLabel(pos);
 	head.syncLast();
 
-	mainWindow->cursorUpdate = 1;
+	__atomic_store_n(&mainWindow->cursorUpdate, 1, __ATOMIC_RELEASE);
 
 	mainWindow->handle_stop(1);
 
@@ -1313,6 +1340,9 @@ MppScoreMain :: handleChordsLoad(void)
 	int base[24];
 	int key[24];
 
+	/* the future scores are also read by other views */
+	mainWindow->atomic_lock();
+
 	memset(score_future_base, 0, sizeof(score_future_base));
 	memset(score_future_treble, 0, sizeof(score_future_treble));
 
@@ -1340,8 +1370,10 @@ MppScoreMain :: handleChordsLoad(void)
 		}
 	}
 
-	if (ns == 0)
+	if (ns == 0) {
+		mainWindow->atomic_unlock();
 		return;
+	}
 
 	MppSort(score, ns);
 
@@ -1375,12 +1407,16 @@ MppScoreMain :: handleChordsLoad(void)
 		}
 	}
 
+	mainWindow->atomic_unlock();
+
 	head.syncLast();
 	head.stepLine(&start, &stop);
 
-	mainWindow->cursorUpdate = 1;
+	__atomic_store_n(&mainWindow->cursorUpdate, 1, __ATOMIC_RELEASE);
 
+	mainWindow->atomic_lock();
 	mainWindow->dlg_bpm->handle_beat_event_locked(unit);
+	mainWindow->atomic_unlock();
 }
 
 /* must be called locked */
@@ -1526,7 +1562,7 @@ MppScoreMain :: handleKeyPressChord(int in_key, int vel, uint32_t key_delay)
 		mainWindow->output_key(mse.trackSec, mse.channelSec,
 		    mse.key, vel, key_delay, 0);
 	}
-	mainWindow->cursorUpdate = 1;
+	__atomic_store_n(&mainWindow->cursorUpdate, 1, __ATOMIC_RELEASE);
 }
 
 /* must be called locked */
@@ -1673,33 +1709,22 @@ MppScoreMain :: handleKeyPressSub(int in_key, int vel,
 				case 2:
 				case 3:
 				case 4:
-					sm = mainWindow->getCurrTransposeView();
 					temp = ptr->value[0] / MPP_BAND_STEP_12;
 
-					if (sm == 0 || temp < 0 || temp >= MPP_MAX_CHORD_FUTURE) {
-						transpose = MPP_KEY_MIN;
-						break;
-					}
+					/* the chord view is not locked by us */
+					mainWindow->atomic_lock();
+					sm = mainWindow->getCurrTransposeView();
 
-					switch (ptr->value[1]) {
-					case 1:
-						mse = sm->score_future_base[temp];
-						break;
-					case 2:
+					if (sm == 0 || temp < 0 || temp >= MPP_MAX_CHORD_FUTURE)
+						memset(&mse, 0, sizeof(mse));
+					else if (ptr->value[1] <= 2)
 						mse = sm->score_future_base[temp];
-						mse.key %= MPP_MAX_BANDS;
-						break;
-					case 3:
-						mse = sm->score_future_treble[temp];
-						break;
-					case 4:
+					else
 						mse = sm->score_future_treble[temp];
+					mainWindow->atomic_unlock();
+
+					if (ptr->value[1] == 2 || ptr->value[1] == 4)
 						mse.key %= MPP_MAX_BANDS;
-						break;
-					default:
-						memset(&mse, 0, sizeof(mse));
-						break;
-					}
 					if (mse.dur == 0) {
 						transpose = MPP_KEY_MIN;
 						break;
@@ -1723,7 +1748,7 @@ MppScoreMain :: handleKeyPressSub(int in_key, int vel,
 				head.jumpLabel(ptr->value[0]);
 
 				/* set frozen keys */
-				memcpy(frozenKeys, pressedKeys, sizeof(frozenKeys));
+				pressedKeys.freeze();
 
 				handleKeyPressSub(in_key, vel,
 				    key_delay, transpose, 0);
@@ -1732,7 +1757,7 @@ MppScoreMain :: handleKeyPressSub(int in_key, int vel,
 				head.popLine();
 
 				/* clear frozen keys */
-				memset(frozenKeys, 0, sizeof(frozenKeys));
+				pressedKeys.thaw();
 				break;
 
 			case MPP_T_SCORE_SUBDIV:
@@ -1810,40 +1835,43 @@ MppScoreMain :: handleKeyPress(int in_key, int vel, uint32_t key_delay)
 
 	/* update cursor, if any */
 
-	mainWindow->cursorUpdate = 1;
+	__atomic_store_n(&mainWindow->cursorUpdate, 1, __ATOMIC_RELEASE);
 
 	/* update bpm, if any */
 
+	mainWindow->atomic_lock();
 	mainWindow->dlg_bpm->handle_beat_event_locked(unit);
+	mainWindow->atomic_unlock();
 }
 
 /* must be called locked */
 void
 MppScoreMain :: decrementDuration(int vel, uint32_t timeout)
 {
+	uint64_t *pkey;
 	int out_key;
 	uint8_t chan;
 	uint8_t delay;
-	uint8_t x;
+	uint32_t x;
 
-	for (x = 0; x != MPP_PRESSED_MAX; x++) {
-		if (frozenKeys[x] != 0)
-			continue;
-		if ((pressedKeys[x] & 0xFF) == 1) {
+	/* iterate backwards, because removal moves the last entry */
+	for (x = pressedKeys.count; x-- != pressedKeys.frozen; ) {
+		pkey = &pressedKeys.entry[x];
 
-			out_key = (pressedKeys[x] >> 32) & -1U;
-			chan = (pressedKeys[x] >> 16) & 0xFF;
-			delay = (pressedKeys[x] >> 24) & 0xFF;
+		if ((*pkey & 0xFF) == 1) {
+
+			out_key = (*pkey >> 32) & -1U;
+			chan = (*pkey >> 16) & 0xFF;
+			delay = (*pkey >> 24) & 0xFF;
 
 			/* clear entry */
-			pressedKeys[x] = 0;
+			pressedKeys.remove(x);
 
 			mainWindow->output_key(MPP_DEFAULT_TRACK(unit), chan,
 			    out_key, -vel, timeout + delay, 0);
+		} else {
+			(*pkey)--;
 		}
-
-		if (pressedKeys[x] != 0)
-			pressedKeys[x] --;
 	}
 }
 
@@ -1916,7 +1944,7 @@ int
 MppScoreMain :: setPressedKey(int chan, int out_key, int dur, int delay)
 {
 	uint64_t temp;
-	uint8_t y;
+	int y;
 
 	dur &= 0xFF;
 	chan &= 0xFF;
@@ -1925,40 +1953,17 @@ MppScoreMain :: setPressedKey(int chan, int out_key, int dur, int delay)
 	temp = dur | ((uint64_t)out_key << 32) | (chan << 16) | (delay << 24);
 
 	if (dur == 0) {
-		/* release key */
-		for (y = 0; y != MPP_PRESSED_MAX; y++) {
-			if (frozenKeys[y] != 0)
-				continue;
-			if ((pressedKeys[y] & 0xFFFFFFFF00FF0000ULL) == (temp & 0xFFFFFFFF00FF0000ULL)) {
-				/* key information matches */
-				/* clear key */
-				pressedKeys[y] = 0;
-			}
-		}
+		/* release key, restart lookup after each removal */
+		while ((y = pressedKeys.find(temp)) > -1)
+			pressedKeys.remove(y);
 		return (0);
 	} else {
 		/* pre-press key */
-		for (y = 0; y != MPP_PRESSED_MAX; y++) {
-			if (frozenKeys[y] != 0)
-				continue;
-			if ((pressedKeys[y] & 0xFFFFFFFF00FF0000ULL) == (temp & 0xFFFFFFFF00FF0000ULL)) {
-				/* key already set */
-				return (1);
-			}
-		}
+		if (pressedKeys.find(temp) > -1)
+			return (1);	/* key already set */
 
 		/* press key */
-		for (y = 0; y != MPP_PRESSED_MAX; y++) {
-			if (frozenKeys[y] != 0)
-				continue;
-			if (pressedKeys[y] != 0)
-				continue;	/* key in use */
-
-			pressedKeys[y] = temp;	/* set key */
-
-			return (0);
-		}
-		return (1);
+		return (pressedKeys.insert(temp) ? 0 : 1);
 	}
 }
 
@@ -1972,9 +1977,7 @@ MppScoreMain :: handleCompile(int force)
 	if (temp != editText || force != 0) {
 		editText = temp;
 
-		mainWindow->atomic_lock();
 		handleParse(editText);
-		mainWindow->atomic_unlock();
 
 		return (1);
 	}
@@ -1984,6 +1987,7 @@ MppScoreMain :: handleCompile(int force)
 void
 MppScoreMain :: watchdog()
 {
+	struct MppPlayState ps;
 	MppElement *curr;
 	int off;
 	int y_blocks;
@@ -2007,9 +2011,8 @@ MppScoreMain :: watchdog()
 
 	/* Compute scrollbar */
 
-	mainWindow->atomic_lock();
-	curr = head.state.curr_start;
-	mainWindow->atomic_unlock();
+	getPlayState(&ps);
+	curr = ps.curr_start;
 
 	/* Compute alignment factor */
 
@@ -2291,47 +2294,85 @@ MppScoreMain :: outputChannelMaskGet(uint16_t *pmask)
 	pmask[MPP_DEFAULT_TRACK(0)] |= m | (m >> 16);
 }
 
-/* must be called locked */
+/*
+ * Returns the number of output targets. Each target is stored in
+ * the outputTargets[] array as the track offset in the upper four
+ * bits and the channel in the lower four bits. The list is only
+ * rebuilt when the output channel mask changes. Must be called
+ * locked.
+ */
+uint8_t
+MppScoreMain :: outputTargetsGet(void)
+{
+	uint16_t mask[MPP_TRACKS_PER_VIEW] = {};
+	uint8_t chan;
+	uint8_t x;
+
+	outputChannelMaskGet(mask);
+
+	if (memcmp(mask, outputMask, sizeof(mask)) == 0)
+		return (outputTargetsNum);
+
+	memcpy(outputMask, mask, sizeof(mask));
+	outputTargetsNum = 0;
+
+	for (chan = 0; chan != 16; chan++) {
+		for (x = 0; x != MPP_TRACKS_PER_VIEW; x++) {
+			if ((mask[x] >> chan) & 1)
+				outputTargets[outputTargetsNum++] = (x << 4) | chan;
+		}
+	}
+	return (outputTargetsNum);
+}
+
+/* must be called with the view lock held */
 void
 MppScoreMain :: outputControl(uint8_t ctrl, uint8_t val)
 {
 	MppMainWindow *mw = mainWindow;
 	struct mid_data *d = &mw->mid_data;
 	const unsigned off = unit * MPP_TRACKS_PER_VIEW;
-	uint16_t ChannelMask[MPP_TRACKS_PER_VIEW] = {};
 	uint8_t chan;
+	uint8_t num;
+	uint8_t x;
+	uint8_t n;
 
-	outputChannelMaskGet(ChannelMask);
+	num = outputTargetsGet();
 
 	/* the control event is distributed to all active channels */
-	for (chan = 0; chan != 16; chan++) {
-		for (unsigned x = 0; x != MPP_TRACKS_PER_VIEW; x++) {
-			if ((ChannelMask[x] >> chan) & 1) {
-				if (mw->check_play(off + x, chan, 0))
-					mid_control(d, ctrl, val);
-				if (mw->check_record(off + x, chan, 0))
-					mid_control(d, ctrl, val);
-				for (unsigned n = 0; n != MPP_LOOP_MAX; n++) {
-					if (mw->tab_loop->check_record(off + x, chan, n))
-						mid_control(d, ctrl, val);
-				}
-			}
+	mw->atomic_lock();
+	for (n = 0; n != num; n++) {
+		x = outputTargets[n] >> 4;
+		chan = outputTargets[n] & 0xF;
+
+		if (mw->check_play(off + x, chan, 0))
+			mid_control(d, ctrl, val);
+		if (mw->check_record(off + x, chan, 0))
+			mid_control(d, ctrl, val);
+		for (uint64_t armed = mw->tab_loop->armed; armed != 0;
+		    armed &= armed - 1) {
+			if (mw->tab_loop->check_record(off + x, chan,
+			    __builtin_ctzll(armed)))
+				mid_control(d, ctrl, val);
 		}
 	}
+	mw->atomic_unlock();
 }
 
-/* must be called locked */
+/* must be called with the view lock held */
 void
 MppScoreMain :: outputChanPressure(uint8_t pressure)
 {
 	MppMainWindow *mw = mainWindow;
 	struct mid_data *d = &mw->mid_data;
 	const unsigned off = unit * MPP_TRACKS_PER_VIEW;
-	uint16_t ChannelMask[MPP_TRACKS_PER_VIEW] = {};
 	uint8_t chan;
+	uint8_t num;
+	uint8_t x;
+	uint8_t n;
 	uint8_t buf[4];
 
-	outputChannelMaskGet(ChannelMask);
+	num = outputTargetsGet();
 
 	buf[0] = 0xD0;
 	buf[1] = pressure & 0x7F;
@@ -2339,54 +2380,63 @@ MppScoreMain :: outputChanPressure(uint8_t pressure)
 	buf[3] = 0;
 
 	/* the pressure event is distributed to all active channels */
-	for (chan = 0; chan != 16; chan++) {
-		for (unsigned x = 0; x != MPP_TRACKS_PER_VIEW; x++) {
-			if ((ChannelMask[x] >> chan) & 1) {
-				if (mw->check_play(off + x, chan, 0))
-					mid_add_raw(d, buf, 2, 0);
-				if (mw->check_record(off + x, chan, 0))
-					mid_add_raw(d, buf, 2, 0);
-				for (unsigned n = 0; n != MPP_LOOP_MAX; n++) {
-					if (mw->tab_loop->check_record(off + x, chan, n))
-						mid_add_raw(d, buf, 2, 0);
-				}
-			}
+	mw->atomic_lock();
+	for (n = 0; n != num; n++) {
+		x = outputTargets[n] >> 4;
+		chan = outputTargets[n] & 0xF;
+
+		if (mw->check_play(off + x, chan, 0))
+			mid_add_raw(d, buf, 2, 0);
+		if (mw->check_record(off + x, chan, 0))
+			mid_add_raw(d, buf, 2, 0);
+		for (uint64_t armed = mw->tab_loop->armed; armed != 0;
+		    armed &= armed - 1) {
+			if (mw->tab_loop->check_record(off + x, chan,
+			    __builtin_ctzll(armed)))
+				mid_add_raw(d, buf, 2, 0);
 		}
 	}
+	mw->atomic_unlock();
 }
 
-/* must be called locked */
+/* must be called with the view lock held */
 void
 MppScoreMain :: outputPitch(uint16_t val)
 {
 	MppMainWindow *mw = mainWindow;
 	struct mid_data *d = &mw->mid_data;
 	const unsigned off = unit * MPP_TRACKS_PER_VIEW;
-	uint16_t ChannelMask[MPP_TRACKS_PER_VIEW] = {};
 	uint8_t chan;
+	uint8_t num;
+	uint8_t x;
+	uint8_t n;
 
-	outputChannelMaskGet(ChannelMask);
+	num = outputTargetsGet();
 
 	/* the pitch event is distributed to all active channels */
-	for (chan = 0; chan != 16; chan++) {
-		for (unsigned x = 0; x != MPP_TRACKS_PER_VIEW; x++) {
-			if ((ChannelMask[x] >> chan) & 1) {
-				if (mw->check_play(off + x, chan, 0))
-					mid_pitch_bend(d, val);
-				if (mw->check_record(off + x, chan, 0))
-					mid_pitch_bend(d, val);
-				for (unsigned n = 0; n != MPP_LOOP_MAX; n++) {
-					if (mw->tab_loop->check_record(off + x, chan, n))
-						mid_pitch_bend(d, val);
-				}
-			}
+	mw->atomic_lock();
+	for (n = 0; n != num; n++) {
+		x = outputTargets[n] >> 4;
+		chan = outputTargets[n] & 0xF;
+
+		if (mw->check_play(off + x, chan, 0))
+			mid_pitch_bend(d, val);
+		if (mw->check_record(off + x, chan, 0))
+			mid_pitch_bend(d, val);
+		for (uint64_t armed = mw->tab_loop->armed; armed != 0;
+		    armed &= armed - 1) {
+			if (mw->tab_loop->check_record(off + x, chan,
+			    __builtin_ctzll(armed)))
+				mid_pitch_bend(d, val);
 		}
 	}
+	mw->atomic_unlock();
 }
 
 int
 MppScoreMain :: getCurrLabel(void)
 {
+	struct MppPlayState ps;
 	int retval = 0;
 	int first = 1;
 	int min = 0;
@@ -2394,12 +2444,8 @@ MppScoreMain :: getCurrLabel(void)
 	int seq;
 	int x;
 
-	mainWindow->atomic_lock();
-	if (head.state.curr_start != 0)
-		seq = head.state.curr_start->sequence;
-	else
-		seq = 0;
-	mainWindow->atomic_unlock();
+	getPlayState(&ps);
+	seq = ps.curr_seq;
 
 	for (x = 0; x != MPP_MAX_LABELS; x++) {
 		if (head.state.label_start[x] == 0)
@@ -2467,3 +2513,46 @@ MppScoreMain :: handleMidiKeyReleaseLocked(int key, int vel)
 		break;
 	}
 }
+
+/* must be called with the view lock held */
+void
+MppScoreMain :: publishPlayStateLocked(void)
+{
+	struct MppPlayState ps;
+
+	memset(&ps, 0, sizeof(ps));
+
+	ps.curr_start = head.state.curr_start;
+	ps.last_start = head.state.last_start;
+	ps.text_curr = head.state.text_curr;
+	if (ps.curr_start != 0) {
+		ps.curr_line = ps.curr_start->line;
+		ps.curr_seq = ps.curr_start->sequence;
+	}
+
+	MppSeqWrite(&playStateSeq, &playState, &ps, sizeof(ps));
+}
+
+/* can be called unlocked */
+void
+MppScoreMain :: getPlayState(struct MppPlayState *ps)
+{
+	MppSeqRead(&playStateSeq, ps, &playState, sizeof(*ps));
+}
+
+/* must be called before the main lock, see "midipp_lock.h" */
+void
+MppScoreMain :: atomicLock(void)
+{
+	lock->lock();
+}
+
+void
+MppScoreMain :: atomicUnlock(void)
+{
+	/* publish play state for lockless readers */
+	if (lock->depth == 1)
+		publishPlayStateLocked();
+
+	lock->unlock();
+}
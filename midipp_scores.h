@@ -28,6 +28,8 @@
 
 #include "midipp.h"
 #include "midipp_element.h"
+#include "midipp_lock.h"
+#include "midipp_pressed.h"
 
 class MppScoreView : public QWidget
 {
@@ -56,6 +58,14 @@ public:
 	void mouseDoubleClickEvent(QMouseEvent *e);
 };
 
+struct MppPlayState {
+	MppElement *curr_start;
+	MppElement *last_start;
+	MppObjectProps text_curr;
+	int curr_line;
+	int curr_seq;
+};
+
 class MppScoreMain : public QObject
 {
 	Q_OBJECT;
@@ -81,6 +91,7 @@ public:
 	void handlePrintSub(QPrinter *pd, QPoint orig);
 	int handleScoreFileOpenSub(QString fname);
 	void outputChannelMaskGet(uint16_t *pmask);
+	uint8_t outputTargetsGet(void);
 	void outputControl(uint8_t ctrl, uint8_t val);
 	void outputChanPressure(uint8_t pressure);
 	void outputPitch(uint16_t val);
@@ -98,8 +109,17 @@ public:
 
 	int setPressedKey(int chan, int out_key, int dur, int delay);
 
+	void publishPlayStateLocked(void);
+	void getPlayState(struct MppPlayState *);
+
+	void atomicLock(void);
+	void atomicUnlock(void);
+
 	MppHead head;
 
+	/* protects "head", key tracking and play state */
+	MppLock *lock;
+
 	uint8_t auto_zero_start[0];
 
 	MppVisualScore *pVisual;
@@ -146,12 +166,19 @@ public:
 	int visual_p_max;
 	int unit;
 
-	uint64_t pressedKeys[MPP_PRESSED_MAX];
-	uint64_t frozenKeys[MPP_PRESSED_MAX];
+	MppPressed pressedKeys;
+
+	struct MppPlayState playState;
+	uint32_t playStateSeq;
 
 	int picScroll;
 	uint32_t active_channels;
 
+	/* cached output channel mask and the resulting targets */
+	uint16_t outputMask[MPP_TRACKS_PER_VIEW];
+	uint8_t outputTargets[16 * MPP_TRACKS_PER_VIEW];
+	uint8_t outputTargetsNum;
+
 	int baseKey;
 	int whatPlayKeyLocked;
 	int chordTranspose;
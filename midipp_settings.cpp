@@ -166,6 +166,9 @@ MppSettings :: doSave(void)
 			case MM_NOTEMODE_SYSEX:
 				setValue("notemode", 1);
 				break;
+			case MM_NOTEMODE_MPE:
+				setValue("notemode", 2);
+				break;
 			default:
 				setValue("notemode", 0);
 				break;
@@ -212,6 +215,7 @@ MppSettings :: doSave(void)
 			setValue("disablelocalkeys", mw->disableLocalKeys[y]);
 			setValue("mutenonchannel", mw->muteAllNonChannel[y]);
 			setValue("muteallcontrol", mw->muteAllControl[y]);
+			setValue("coalesce", mw->txCoalesceWindow[y]);
 			for (x = 0; x != MPP_MAX_VIEWS; x++)
 				setValue(concat("view%d", x), (int)mw->cbx_config_dev[y][1 + x]->isChecked());
 			for (x = 0; x != 16; x++)
@@ -326,6 +330,7 @@ MppSettings :: doLoad(void)
 			if (songEvents < 0 || songEvents > 1)
 				songEvents = 0;
 
+			mw->scores_main[x]->atomicLock();
 			mw->atomic_lock();
 			mw->scores_main[x]->baseKey = baseKey * MPP_BAND_STEP_192;
 			mw->scores_main[x]->delayNoise = delayNoise;
@@ -353,6 +358,9 @@ MppSettings :: doLoad(void)
 			case 1:
 				mw->scores_main[x]->noteMode = MM_NOTEMODE_SYSEX;
 				break;
+			case 2:
+				mw->scores_main[x]->noteMode = MM_NOTEMODE_MPE;
+				break;
 			default:
 				mw->scores_main[x]->noteMode = MM_NOTEMODE_NORMAL;
 				break;
@@ -374,7 +382,10 @@ MppSettings :: doLoad(void)
 			mw->scores_main[x]->chordContrast = chordContrast;
 			mw->scores_main[x]->chordNormalize = chordNormalize;
 			mw->scores_main[x]->songEventsOn = songEvents;
+			mw->tx_route_update_locked();
+			mw->rx_route_update_locked();
 			mw->atomic_unlock();
+			mw->scores_main[x]->atomicUnlock();
 
 			mw->dlg_mode[x]->update_all();
 		}
@@ -413,6 +424,10 @@ MppSettings :: doLoad(void)
 			int disableLocalKeys = valueDefault(concat("device%d/disablelocalkeys", y), 0) ? 1 : 0;
 			int muteAllControl = valueDefault(concat("device%d/muteallcontrol", y), 0) ? 1 : 0;
 			int muteAllNonChannel = valueDefault(concat("device%d/mutenonchannel", y), 0) ? 1 : 0;
+			int coalesce = valueDefault(concat("device%d/coalesce", y), 0);
+
+			if (coalesce < 0 || coalesce > 255)
+				coalesce = 0;
 
 			int mute[16];
 
@@ -426,9 +441,11 @@ MppSettings :: doLoad(void)
 			mw->disableLocalKeys[y] = disableLocalKeys; 
 			mw->muteAllControl[y] = muteAllControl;
 			mw->muteAllNonChannel[y] = muteAllNonChannel; 
+			__atomic_store_n(&mw->txCoalesceWindow[y], coalesce, __ATOMIC_RELAXED);
 
 			for (x = 0; x != 16; x++)
 				mw->muteMap[y][x] = mute[x];
+			mw->tx_route_update_locked();
 			mw->atomic_unlock();
 		}
 	}
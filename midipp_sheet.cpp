@@ -439,6 +439,7 @@ void
 MppSheet::paintEvent(QPaintEvent * event)
 {
 	MppScoreMain *sm = mw->scores_main[unit];
+	struct MppPlayState ps;
   	MppElement *curr;
 	MppElement *last;
 	QPainter paint(this);
@@ -463,18 +464,17 @@ MppSheet::paintEvent(QPaintEvent * event)
 	sizeInit();
 	paint.setFont(mw->editFont);
 	
-	mw->atomic_lock();
-	curr = sm->head.state.curr_start;
+	sm->getPlayState(&ps);
+	curr = ps.curr_start;
 	if (curr != 0)
 		curr_line = curr->line;
 	else
 		curr_line = -1;
-	last = sm->head.state.last_start;
+	last = ps.last_start;
 	if (last != 0)
 		last_line = last->line;
 	else
 		last_line = -1;
-	mw->atomic_unlock();
 
 	if (curr_line > -1) {
 		for (x = 0; x != num_cols; x++) {
@@ -726,13 +726,13 @@ MppSheet :: watchdog()
 {
 	MppScoreMain *sm = mw->scores_main[unit];
 	int delta = (width() - xoff) / boxs;
+	struct MppPlayState ps;
 	MppElement *curr;
 	ssize_t x;
 	int y;
 
-	mw->atomic_lock();
-	curr = sm->head.state.curr_start;
-	mw->atomic_unlock();
+	sm->getPlayState(&ps);
+	curr = ps.curr_start;
 
 	/* range check */
 	if (delta < 1)
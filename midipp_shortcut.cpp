@@ -56,6 +56,7 @@ MppShortcutTab :: MppShortcutTab(MppMainWindow *_mw)
 	connect(watchdog, SIGNAL(timeout()), this, SLOT(handle_watchdog()));
 
 	memset(filter, 0, sizeof(filter));
+	memset(filter_map, 0, sizeof(filter_map));
 
 	memset(shortcut_desc, 0, sizeof(shortcut_desc));
 
@@ -147,15 +148,54 @@ MppShortcutTab :: ~MppShortcutTab()
 	watchdog->stop();
 }
 
+/* must be called locked */
+void
+MppShortcutTab :: compile_locked(void)
+{
+	MppShortcutCompile(filter_map, filter, MPP_SHORTCUT_MAX);
+}
+
+/*
+ * This function is called locked. Returns a bitmap of all shortcuts
+ * matching the given status and data bytes. The channel is ignored.
+ * The status byte must have the most significant bit set.
+ */
+uint32_t
+MppShortcutTab :: lookup_locked(const uint8_t *match, uint8_t any_velocity)
+{
+	return (MppShortcutLookup(filter_map, filter, match, any_velocity));
+}
+
+/*
+ * This function is called locked. Returns non-zero if the event
+ * matches a jump shortcut, which requires all views to be locked.
+ */
+uint8_t
+MppShortcutTab :: is_jump_event_locked(struct umidi20_event *event)
+{
+	uint8_t match[3] = {event->cmd[1],event->cmd[2],event->cmd[3]};
+	uint8_t key_start;
+
+	/* key end events never jump */
+	if ((match[0] & 0x80) == 0 || umidi20_event_is_key_end(event))
+		return (0);
+
+	key_start = umidi20_event_is_key_start(event);
+	if (key_start)
+		match[0] = 0x90;
+
+	/* ignore velocity of key presses */
+	return ((lookup_locked(match, key_start) & MPP_SHORTCUT_JUMP_MASK) != 0);
+}
+
 /* this function is called locked */
 uint8_t
 MppShortcutTab :: handle_event_received_locked(MppScoreMain *sm,
-    struct umidi20_event *event)
+    struct umidi20_event *event, uint32_t views)
 {
 	uint8_t match[3] = {event->cmd[1],event->cmd[2],event->cmd[3]};
-	uint8_t mask[3] = {0xF0,0xFF,0xFF};
+	uint32_t mask;
 	uint32_t x;
-	uint8_t found = 0;
 
 	/* check for start of MIDI command */
 	if ((match[0] & 0x80) == 0)
@@ -164,7 +204,6 @@ MppShortcutTab :: handle_event_received_locked(MppScoreMain *sm,
 	/* key end is not a valid event */
 	if (umidi20_event_is_key_end(event)) {
 		match[0] = 0x90;
-		mask[2] = 0;	/* ignore velocity */
 
 		/* if passing all keys, magic commands don't work */
 		switch (sm->keyMode) {
@@ -173,18 +212,10 @@ MppShortcutTab :: handle_event_received_locked(MppScoreMain *sm,
 		default:
 			break;
 		}
-		for (x = 0; x != MPP_SHORTCUT_MAX; x++) {
-			if (((filter[x][0] ^ match[0]) & mask[0]) ||
-			    ((filter[x][1] ^ match[1]) & mask[1]) ||
-			    ((filter[x][2] ^ match[2]) & mask[2]))
-				continue;
-			/* mask due to key-press match */
-			return (1);
-		}
-		return (0);
+		/* mask due to key-press match, ignoring velocity */
+		return (lookup_locked(match, 1) != 0);
 	} else if (umidi20_event_is_key_start(event)) {
 		match[0] = 0x90;
-		mask[2] = 0;	/* ignore velocity */
 
 		/* if passing all keys, magic commands don't work */
 		switch (sm->keyMode) {
@@ -193,16 +224,20 @@ MppShortcutTab :: handle_event_received_locked(MppScoreMain *sm,
 		default:
 			break;
 		}
+		/* ignore velocity */
+		mask = lookup_locked(match, 1);
+	} else {
+		mask = lookup_locked(match, 0);
 	}
-	for (x = 0; x != MPP_SHORTCUT_MAX; x++) {
-		if (((filter[x][0] ^ match[0]) & mask[0]) ||
-		    ((filter[x][1] ^ match[1]) & mask[1]) ||
-		    ((filter[x][2] ^ match[2]) & mask[2]))
+	if (mask == 0)
+		return (0);
+
+	for (x = 0; mask != 0; x++, mask >>= 1) {
+		if ((mask & 1) == 0)
 			continue;
-		found = 1;
 		switch (x) {
 		case MPP_SHORTCUT_J0 ... MPP_SHORTCUT_J15:
-			mw->handle_jump_locked(x - MPP_SHORTCUT_J0);
+			mw->handle_jump_locked(x - MPP_SHORTCUT_J0, views);
 			break;
 		case MPP_SHORTCUT_ALL:
 			sm->keyMode = MM_PASS_ALL;
@@ -230,26 +265,31 @@ MppShortcutTab :: handle_event_received_locked(MppScoreMain *sm,
 			break;
 		case MPP_SHORTCUT_TRIGGER:
 			mw->handle_midi_trigger();
-			mw->doOperation &=
-			    ~(MPP_OPERATION_PAUSE|MPP_OPERATION_REWIND);
+			__atomic_fetch_and(&mw->doOperation,
+			    ~(MPP_OPERATION_PAUSE|MPP_OPERATION_REWIND),
+			    __ATOMIC_RELEASE);
 			break;
 		case MPP_SHORTCUT_PAUSE:
-			mw->doOperation |= MPP_OPERATION_PAUSE;
+			__atomic_fetch_or(&mw->doOperation,
+			    MPP_OPERATION_PAUSE, __ATOMIC_RELEASE);
 			break;
 		case MPP_SHORTCUT_REWIND:
-			mw->doOperation &= ~MPP_OPERATION_PAUSE;
-			mw->doOperation |= MPP_OPERATION_REWIND;
+			__atomic_fetch_and(&mw->doOperation,
+			    ~MPP_OPERATION_PAUSE, __ATOMIC_RELEASE);
+			__atomic_fetch_or(&mw->doOperation,
+			    MPP_OPERATION_REWIND, __ATOMIC_RELEASE);
 			break;
 		case MPP_SHORTCUT_BPM_TOGGLE:
 			mw->dlg_bpm->enabled ^= 1;
 			mw->dlg_bpm->handle_update(mw->dlg_bpm->enabled);
-			mw->doOperation |= MPP_OPERATION_BPM;
+			__atomic_fetch_or(&mw->doOperation,
+			    MPP_OPERATION_BPM, __ATOMIC_RELEASE);
 			break;
 		default:
 			break;
 		}
 	}
-	return (found);
+	return (1);
 }
 
 void
@@ -266,6 +306,7 @@ MppShortcutTab :: handle_record(int x)
 void
 MppShortcutTab :: handle_watchdog()
 {
+	uint8_t temp[MPP_SHORTCUT_MAX][3];
 	int n;
 
 	for (n = 0; n != MPP_SHORTCUT_MAX; n++) {
@@ -298,12 +339,29 @@ MppShortcutTab :: handle_watchdog()
 			}
 		}
 
-		mw->atomic_lock();
-		filter[n][0] = buf[0];
-		filter[n][1] = buf[1];
-		filter[n][2] = buf[2];
-		mw->atomic_unlock();
+		temp[n][0] = buf[0];
+		temp[n][1] = buf[1];
+		temp[n][2] = buf[2];
 	}
+
+	/* filters are only written by this thread */
+	for (n = 0; n != MPP_SHORTCUT_MAX; n++) {
+		if (filter[n][0] != temp[n][0] ||
+		    filter[n][1] != temp[n][1] ||
+		    filter[n][2] != temp[n][2])
+			break;
+	}
+	if (n == MPP_SHORTCUT_MAX)
+		return;
+
+	mw->atomic_lock();
+	for (n = 0; n != MPP_SHORTCUT_MAX; n++) {
+		filter[n][0] = temp[n][0];
+		filter[n][1] = temp[n][1];
+		filter[n][2] = temp[n][2];
+	}
+	compile_locked();
+	mw->atomic_unlock();
 }
 
 void
@@ -28,6 +28,8 @@
 
 #include "midipp.h"
 
+#include "midipp_shortcutmap.h"
+
 enum {
 	MPP_SHORTCUT_J0 = 0,
 	MPP_SHORTCUT_J1,
@@ -62,6 +64,10 @@ enum {
 	MPP_SHORTCUT_MAX,
 };
 
+static_assert(MPP_SHORTCUT_MAX <= 32, "shortcuts must fit a 32-bit mask");
+
+#define	MPP_SHORTCUT_JUMP_MASK ((1U << MPP_SHORTCUT_LABEL_MAX) - 1U)
+
 class MppShortcutTab : public QObject
 {
 	Q_OBJECT;
@@ -76,6 +82,9 @@ public:
 
 	uint8_t filter[MPP_SHORTCUT_MAX][4];
 
+	/* compiled filters, updated together with the filters */
+	MppShortcutMap filter_map;
+
 	MppGridLayout *gl;
 	MppGroupBox *gb_jump;
 	MppGroupBox *gb_mode;
@@ -90,7 +99,10 @@ public:
 	QLineEdit *led_cmd[MPP_SHORTCUT_MAX];
 	QTimer *watchdog;
 
-	uint8_t handle_event_received_locked(MppScoreMain *, struct umidi20_event *);
+	uint8_t handle_event_received_locked(MppScoreMain *, struct umidi20_event *, uint32_t);
+	uint8_t is_jump_event_locked(struct umidi20_event *);
+	uint32_t lookup_locked(const uint8_t *, uint8_t);
+	void compile_locked(void);
 	void handle_record_event(const uint8_t *);
 	void handle_update();
 
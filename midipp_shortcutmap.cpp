@@ -0,0 +1,65 @@
+/*-
+ * Copyright (c) 2019 Hans Petter Selasky. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "midipp_shortcutmap.h"
+
+void
+MppShortcutCompile(MppShortcutMap map, const uint8_t (*filter)[4], uint32_t num)
+{
+	uint32_t x;
+
+	memset(map, 0, sizeof(MppShortcutMap));
+
+	for (x = 0; x != num; x++) {
+		/* filters without a status byte never match */
+		if ((filter[x][0] & 0x80) == 0)
+			continue;
+		map[(filter[x][0] >> 4) & 7][filter[x][1]] |= (1U << x);
+	}
+}
+
+/*
+ * Returns a bitmap of all filters matching the given status and data
+ * bytes. The channel is ignored. The status byte must have the most
+ * significant bit set.
+ */
+uint32_t
+MppShortcutLookup(const MppShortcutMap map, const uint8_t (*filter)[4],
+    const uint8_t *match, uint8_t any_velocity)
+{
+	uint32_t mask;
+	uint32_t found;
+	uint32_t x;
+
+	mask = map[(match[0] >> 4) & 7][match[1]];
+	if (mask == 0 || any_velocity != 0)
+		return (mask);
+
+	for (found = 0, x = 0; mask != 0; x++, mask >>= 1) {
+		if ((mask & 1) != 0 && filter[x][2] == match[2])
+			found |= (1U << x);
+	}
+	return (found);
+}
@@ -0,0 +1,43 @@
+/*-
+ * Copyright (c) 2019 Hans Petter Selasky. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _MIDIPP_SHORTCUTMAP_H_
+#define	_MIDIPP_SHORTCUTMAP_H_
+
+#include "midipp.h"
+
+/*
+ * Shortcut filters compiled into a bitmap of candidate shortcuts,
+ * indexed by the upper status nibble and the first data byte. Each
+ * filter holds a status byte, the first data byte and a velocity.
+ * At most 32 filters are supported. This file does not depend on
+ * Qt, so that it can be tested standalone.
+ */
+typedef uint32_t MppShortcutMap[8][256];
+
+extern void MppShortcutCompile(MppShortcutMap, const uint8_t (*)[4], uint32_t);
+extern uint32_t MppShortcutLookup(const MppShortcutMap, const uint8_t (*)[4], const uint8_t *, uint8_t);
+
+#endif		/* _MIDIPP_SHORTCUTMAP_H_ */
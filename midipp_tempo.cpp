@@ -0,0 +1,132 @@
+/*-
+ * Copyright (c) 2019 Hans Petter Selasky. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "midipp_tempo.h"
+
+MppTempo :: MppTempo(void)
+{
+	num = 60000;
+	den = 120;
+	ideal = 0;
+	frac = 0;
+	error = 0;
+	ahead = 0;
+	valid = 0;
+}
+
+/* set beat period to "n / d" milliseconds, keeping the phase */
+void
+MppTempo :: setPeriod(uint32_t n, uint32_t d)
+{
+	if (d == 0)
+		d = 1;
+	if (n == 0)
+		n = 1;
+	if (d != den)
+		frac = (uint32_t)(((uint64_t)frac * d) / den);
+	num = n;
+	den = d;
+}
+
+/* the next beat starts a new phase */
+void
+MppTempo :: resync(void)
+{
+	valid = 0;
+}
+
+/* must be called at every timer callback with the current time in ms */
+void
+MppTempo :: beat(uint32_t pos)
+{
+	uint32_t quot = num / den;
+
+	/* the beat belonging to this callback is still ahead */
+	pos += ahead;
+
+	if (valid != 0) {
+		/* advance ideal beat time by exactly one period */
+		ideal += quot;
+		frac += num % den;
+		if (frac >= den) {
+			frac -= den;
+			ideal++;
+		}
+		error = (int32_t)(pos - ideal);
+
+		/* check if the lock was lost, for example after a pause */
+		if (error > (int32_t)(quot / 2) || -error > (int32_t)(quot / 2))
+			valid = 0;
+	}
+
+	if (valid == 0) {
+		ideal = pos;
+		frac = 0;
+		error = 0;
+		valid = 1;
+	}
+}
+
+/* returns the corrected delay in ms until the next beat */
+uint32_t
+MppTempo :: delay(void)
+{
+	int32_t temp;
+
+	temp = num / den;
+	if (frac + (num % den) >= den)
+		temp++;
+
+	/* correct half of the phase error */
+	temp -= error / 2;
+
+	if (temp < 1)
+		temp = 1;
+	return (temp);
+}
+
+/*
+ * Returns the delay in ms from "pos" until the timer should fire for
+ * the beat one period after the last one. Used to restart the timer
+ * when the period changes between beats. If that beat is already
+ * due, the next beat starts a new phase instead.
+ */
+uint32_t
+MppTempo :: next(uint32_t pos)
+{
+	int32_t temp;
+
+	temp = num / den;
+	if (frac + (num % den) >= den)
+		temp++;
+
+	temp += (int32_t)(ideal - pos) - (int32_t)ahead;
+
+	if (temp < 1) {
+		valid = 0;
+		temp = 1;
+	}
+	return (temp);
+}
@@ -0,0 +1,59 @@
+/*-
+ * Copyright (c) 2019 Hans Petter Selasky. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _MIDIPP_TEMPO_H_
+#define	_MIDIPP_TEMPO_H_
+
+#include "midipp.h"
+
+/*
+ * Tempo clock for periodic beat timers. The beat period is kept as
+ * an exact fraction of milliseconds, so that rounding to whole timer
+ * ticks does not accumulate. At every beat the phase error between
+ * the actual and the ideal beat time is measured, and half of it is
+ * corrected in the next timer period. The timer may be set to fire
+ * "ahead" milliseconds before each beat. All functions must be
+ * called with the main lock held.
+ */
+class MppTempo {
+public:
+	MppTempo(void);
+
+	void setPeriod(uint32_t, uint32_t);
+	void resync(void);
+	void beat(uint32_t);
+	uint32_t delay(void);
+	uint32_t next(uint32_t);
+
+	uint32_t num;		/* period numerator in ms */
+	uint32_t den;		/* period denominator */
+	uint32_t ideal;		/* ideal time of last beat in ms */
+	uint32_t frac;		/* fraction of ideal, in 1/den ms */
+	int32_t error;		/* phase error of last beat in ms */
+	uint32_t ahead;		/* timer fires this many ms before the beat */
+	uint8_t valid;
+};
+
+#endif		/* _MIDIPP_TEMPO_H_ */
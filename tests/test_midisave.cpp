@@ -0,0 +1,233 @@
+/*-
+ * Copyright (c) 2019 Hans Petter Selasky. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Times synthetic MIDI input while a song having one million events
+ * is saved, comparing the old way of encoding with the main lock
+ * held against the snapshot used by MppMidiSave, which copies the
+ * events under the main lock and encodes them afterwards. Needs
+ * libumidi20, but not Qt.
+ */
+
+#include <err.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <umidi20.h>
+
+#define	EVENTS	1000000		/* note on and off events */
+
+static pthread_mutex_t mtx;	/* like MppMainWindow::mtx */
+static struct umidi20_song *song;
+static struct umidi20_track *track;
+
+static volatile int rx_stop;
+static uint32_t rx_max;		/* largest lock wait in us */
+static uint32_t rx_late;	/* lock waits above 5 ms */
+static uint32_t rx_count;
+
+static uint32_t
+now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000);
+}
+
+/* takes the main lock every millisecond, like received events do */
+static void *
+rx_thread(void *arg)
+{
+	uint32_t t;
+
+	while (rx_stop == 0) {
+		usleep(1000);
+
+		t = now_us();
+		pthread_mutex_lock(&mtx);
+		t = now_us() - t;
+		pthread_mutex_unlock(&mtx);
+
+		if (t > rx_max)
+			rx_max = t;
+		if (t > 5000)
+			rx_late++;
+		rx_count++;
+	}
+	return (NULL);
+}
+
+static void
+song_fill(void)
+{
+	struct mid_data d;
+	uint32_t n;
+
+	memset(&d, 0, sizeof(d));
+
+	pthread_mutex_lock(&mtx);
+	song = umidi20_song_alloc(&mtx, UMIDI20_FILE_FORMAT_TYPE_0, 500,
+	    UMIDI20_FILE_DIVISION_TYPE_PPQ);
+	track = umidi20_track_alloc();
+	if (song == NULL || track == NULL)
+		errx(1, "Out of memory");
+	umidi20_song_track_add(song, NULL, track, 0);
+
+	d.track = track;
+	mid_set_channel(&d, 0);
+	mid_set_device_no(&d, 0xFF);
+
+	/* every key press gives a note on and a note off event */
+	for (n = 0; n != EVENTS / 2; n++) {
+		mid_set_position(&d, n * 4);
+		mid_key_press(&d, 36 + (n % 48), 64, 2);
+	}
+	pthread_mutex_unlock(&mtx);
+}
+
+/* the old way, encoding with the main lock held */
+static uint32_t
+save_locked(void)
+{
+	uint8_t *data;
+	uint32_t len;
+	uint32_t t;
+
+	t = now_us();
+	pthread_mutex_lock(&mtx);
+	if (umidi20_save_file(song, &data, &len) != 0)
+		errx(1, "Could not encode song");
+	pthread_mutex_unlock(&mtx);
+	t = now_us() - t;
+
+	free(data);
+	return (t);
+}
+
+/* the way of MppMidiSave, copying under the lock and encoding after */
+static uint32_t
+save_snapshot(void)
+{
+	struct umidi20_event *event;
+	struct umidi20_event *event_copy;
+	struct umidi20_song *copy;
+	struct umidi20_track *copy_track;
+	pthread_mutex_t copy_mtx;
+	uint8_t *data;
+	uint32_t len;
+	uint32_t t;
+
+	umidi20_mutex_init(&copy_mtx);
+
+	t = now_us();
+	pthread_mutex_lock(&copy_mtx);
+	copy = umidi20_song_alloc(&copy_mtx, UMIDI20_FILE_FORMAT_TYPE_0, 500,
+	    UMIDI20_FILE_DIVISION_TYPE_PPQ);
+	copy_track = umidi20_track_alloc();
+	if (copy == NULL || copy_track == NULL)
+		errx(1, "Out of memory");
+	umidi20_song_track_add(copy, NULL, copy_track, 0);
+
+	pthread_mutex_lock(&mtx);
+	UMIDI20_QUEUE_FOREACH(event, &track->queue) {
+		event_copy = umidi20_event_copy(event, 0);
+		if (event_copy == NULL)
+			errx(1, "Out of memory");
+		umidi20_event_queue_insert(&copy_track->queue,
+		    event_copy, UMIDI20_CACHE_INPUT);
+	}
+	pthread_mutex_unlock(&mtx);
+
+	if (umidi20_save_file(copy, &data, &len) != 0)
+		errx(1, "Could not encode song");
+	umidi20_song_free(copy);
+	pthread_mutex_unlock(&copy_mtx);
+	t = now_us() - t;
+
+	pthread_mutex_destroy(&copy_mtx);
+
+	free(data);
+	return (t);
+}
+
+static uint32_t
+run(uint32_t (*fn)(void), const char *name)
+{
+	pthread_t td;
+	uint32_t t;
+
+	rx_stop = 0;
+	rx_max = 0;
+	rx_late = 0;
+	rx_count = 0;
+
+	if (pthread_create(&td, NULL, &rx_thread, NULL) != 0)
+		errx(1, "Could not create thread");
+
+	usleep(100000);
+	t = fn();
+	usleep(100000);
+
+	rx_stop = 1;
+	pthread_join(td, NULL);
+
+	printf("%-8s save %u ms, largest RX lock wait %u us, "
+	    "%u of %u waits above 5 ms\n", name, t / 1000, rx_max,
+	    rx_late, rx_count);
+	return (rx_max);
+}
+
+int
+main(void)
+{
+	uint32_t locked;
+	uint32_t snapshot;
+
+	umidi20_init();
+	umidi20_mutex_init(&mtx);
+
+	song_fill();
+
+	locked = run(&save_locked, "locked");
+	snapshot = run(&save_snapshot, "snapshot");
+
+	pthread_mutex_lock(&mtx);
+	umidi20_song_free(song);
+	pthread_mutex_unlock(&mtx);
+
+	/* the snapshot only holds the main lock while copying */
+	if (snapshot >= locked) {
+		printf("test_midisave: snapshot does not reduce RX latency\n");
+		return (1);
+	}
+	printf("test_midisave: OK\n");
+	return (0);
+}
@@ -0,0 +1,136 @@
+/*-
+ * Copyright (c) 2019 Hans Petter Selasky. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Compares the compiled shortcut bitmap against the linear matcher
+ * it replaced, for every shortcut mask, all 16 channels, all 128
+ * keys and a set of velocities. Standalone, no Qt needed.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define	_MIDIPP_H_		/* skip the Qt based main header */
+#include "../midipp_shortcutmap.cpp"
+
+#define	NFILTER	32
+
+static uint8_t filter[NFILTER][4];
+static MppShortcutMap map;
+
+/* the matcher used before the filters were compiled */
+static uint32_t
+linear_lookup(const uint8_t *match, uint8_t any_velocity)
+{
+	uint8_t mask[3] = {0xF0,0xFF,0xFF};
+	uint32_t found = 0;
+	uint32_t x;
+
+	if (any_velocity)
+		mask[2] = 0;
+
+	for (x = 0; x != NFILTER; x++) {
+		if (((filter[x][0] ^ match[0]) & mask[0]) ||
+		    ((filter[x][1] ^ match[1]) & mask[1]) ||
+		    ((filter[x][2] ^ match[2]) & mask[2]))
+			continue;
+		found |= (1U << x);
+	}
+	return (found);
+}
+
+static void
+random_filters(void)
+{
+	static const uint8_t status[] = {
+		0x00, 0x80, 0x90, 0xA0, 0xB0, 0xC0, 0xD0, 0xE0
+	};
+	uint32_t x;
+
+	for (x = 0; x != NFILTER; x++) {
+		filter[x][0] = status[random() % 8] | (random() % 16);
+		/* keep collisions likely */
+		filter[x][1] = 60 + (random() % 4);
+		filter[x][2] = (random() % 2) ? 0 : (random() % 128);
+		filter[x][3] = 0;
+	}
+}
+
+int
+main(void)
+{
+	static const uint8_t velocity[] = { 0, 1, 64, 127 };
+	uint8_t match[3];
+	uint32_t errors = 0;
+	uint32_t round;
+	uint32_t status;
+	uint32_t chan;
+	uint32_t key;
+	uint32_t v;
+	uint32_t any;
+
+	srandom(1);
+
+	for (round = 0; round != 256; round++) {
+		random_filters();
+		MppShortcutCompile(map, filter, NFILTER);
+
+		for (status = 0x80; status != 0x100; status += 0x10) {
+		for (chan = 0; chan != 16; chan++) {
+		for (key = 0; key != 128; key++) {
+		for (v = 0; v != sizeof(velocity); v++) {
+		for (any = 0; any != 2; any++) {
+			uint32_t a;
+			uint32_t b;
+
+			match[0] = status | chan;
+			match[1] = key;
+			match[2] = velocity[v];
+
+			a = MppShortcutLookup(map, filter, match, any);
+			b = linear_lookup(match, any);
+			if (a == b)
+				continue;
+			if (errors++ < 10) {
+				printf("Mismatch for %02x %02x %02x any=%u: "
+				    "0x%08x != 0x%08x\n", match[0], match[1],
+				    match[2], any, a, b);
+			}
+		}
+		}
+		}
+		}
+		}
+	}
+
+	if (errors != 0) {
+		printf("test_shortcut: %u mismatches\n", errors);
+		return (1);
+	}
+	printf("test_shortcut: OK\n");
+	return (0);
+}
@@ -0,0 +1,226 @@
+/*-
+ * Copyright (c) 2019 Hans Petter Selasky. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Simulates the BPM and metronome timers driving MppTempo for one
+ * hour, without Qt or libumidi20. The simulated timer fires "delay()" milliseconds
+ * after the callback was entered, so that any callback latency is
+ * carried into the next period unless the tempo clock corrects it.
+ * The callback latency is random, with occasional long stalls like
+ * those of a contended main lock.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define	_MIDIPP_H_		/* skip the Qt based main header */
+#include "../midipp_tempo.cpp"
+
+#define	HOUR	(60U * 60U * 1000U)	/* ms */
+#define	AHEAD	20			/* ms, see MPP_METRONOME_AHEAD */
+
+static uint32_t
+latency(uint32_t jitter, uint32_t stall)
+{
+	/* one callback out of 64 hits a contended lock */
+	if (stall != 0 && (random() % 64) == 0)
+		return (stall);
+	return (random() % (jitter + 1));
+}
+
+/*
+ * Runs the beat timer for one hour at "n / d" ms per beat and returns
+ * the largest distance between a beat and its exact time. The old
+ * fixed integer period is simulated when "fixed" is set. Else the
+ * ideal beat time of the tempo clock must be exact, which is counted
+ * in "pslip" otherwise.
+ */
+static uint32_t
+run_drift(uint32_t n, uint32_t d, uint32_t jitter, uint32_t stall, int fixed,
+    uint32_t *pslip)
+{
+	MppTempo tempo;
+	uint64_t beats = 0;
+	uint32_t t0 = 1000;
+	uint32_t t = t0;
+	uint32_t maxerr = 0;
+	uint32_t ideal0 = 0;
+	uint32_t now;
+	int64_t err;
+
+	tempo.setPeriod(n, d);
+	*pslip = 0;
+
+	while (t - t0 < HOUR) {
+		now = t + latency(jitter, stall);
+		tempo.beat(now);
+
+		if (beats == 0)
+			ideal0 = tempo.ideal;
+		else if (tempo.ideal - ideal0 != (uint32_t)((beats * n) / d))
+			(*pslip)++;
+
+		/* distance from the exact beat time */
+		err = (int64_t)(now - ideal0) - (int64_t)((beats * n) / d);
+		if (err < 0)
+			err = -err;
+		if ((uint32_t)err > maxerr)
+			maxerr = err;
+
+		t = now + (fixed ? (n / d) : tempo.delay());
+		beats++;
+	}
+	return (maxerr);
+}
+
+/*
+ * Runs the metronome timer, which fires AHEAD ms before each beat
+ * and timestamps the click at the ideal beat time, like
+ * MppMetronomeOffset(). Half way, at a random point within the
+ * beat, the tempo changes to "bpm_b" and the timer is restarted
+ * like handleBPMChanged() does. Returns the number of click
+ * spacings outside the expected range.
+ */
+static uint32_t
+run_clicks(uint32_t bpm_a, uint32_t bpm_b, uint32_t jitter, uint32_t stall,
+    uint32_t *pclicks)
+{
+	MppTempo tempo;
+	uint32_t bpm = bpm_a;
+	uint32_t t0 = 1000;
+	uint32_t t = t0 + 60000 / bpm;
+	uint32_t change = t0 + (HOUR / 2) + (random() % (60000 / bpm));
+	uint32_t last = 0;
+	uint32_t clicks = 0;
+	uint32_t bad = 0;
+	uint32_t min;
+	uint32_t max;
+	uint32_t now;
+	uint32_t click;
+	int32_t off;
+	int changed = 0;
+
+	tempo.setPeriod(60000, bpm);
+	tempo.ahead = AHEAD;
+
+	while (t - t0 < HOUR) {
+		if (bpm != bpm_b && (int32_t)(t - change) >= 0) {
+			bpm = bpm_b;
+			tempo.setPeriod(60000, bpm);
+			t = change + tempo.next(change);
+			changed = 1;
+		}
+
+		now = t + latency(jitter, stall);
+		tempo.beat(now);
+		t = now + tempo.delay();
+
+		off = (int32_t)(tempo.ideal - now);
+		if (off < 0)
+			off = 0;
+		click = now + off;
+
+		/* the exact period is between these */
+		min = 60000 / bpm;
+		max = (60000 + bpm - 1) / bpm;
+
+		/*
+		 * The first click at a new tempo comes one new period
+		 * after the last click, or right away if that is
+		 * already past.
+		 */
+		if (changed == 1) {
+			changed = 2;
+			if (max < (60000 + bpm_a - 1) / bpm_a + 2 * stall + 1)
+				max = (60000 + bpm_a - 1) / bpm_a + 2 * stall + 1;
+		}
+
+		if (clicks++ != 0 && (click - last < min || click - last > max)) {
+			if (bad++ < 5) {
+				printf("Click spacing %u ms at %u ms, "
+				    "expected %u..%u ms\n", click - last,
+				    click - t0, min, max);
+			}
+		}
+		last = click;
+	}
+	*pclicks = clicks;
+	return (bad);
+}
+
+int
+main(void)
+{
+	static const uint32_t bpm[] = { 60, 97, 113, 120, 127, 140, 173, 240 };
+	uint32_t errors = 0;
+	uint32_t slip;
+	uint32_t fixed;
+	uint32_t err;
+	uint32_t clicks;
+	uint32_t x;
+
+	srandom(1);
+
+	for (x = 0; x != sizeof(bpm) / sizeof(bpm[0]); x++) {
+		fixed = run_drift(60000, bpm[x], 5, 30, 1, &slip);
+		err = run_drift(60000, bpm[x], 5, 30, 0, &slip);
+
+		printf("%3u BPM: max beat error %u ms over one hour, "
+		    "%u ms with a fixed period\n", bpm[x], err, fixed);
+
+		/*
+		 * Half of the phase error is corrected per beat, so
+		 * the beats settle at most twice the largest callback
+		 * latency late. The error must not accumulate.
+		 */
+		if (err > 2 * 30 + 1 || slip != 0)
+			errors++;
+	}
+
+	for (x = 0; x != sizeof(bpm) / sizeof(bpm[0]); x++) {
+		uint32_t other = bpm[(x + 3) % (sizeof(bpm) / sizeof(bpm[0]))];
+
+		/*
+		 * The clicks are timestamped at the ideal beat time as
+		 * long as the timer is less than AHEAD late, that is
+		 * while the callback latency stays below AHEAD / 2.
+		 */
+		err = run_clicks(bpm[x], other, 5, (AHEAD / 2) - 1, &clicks);
+
+		printf("%3u -> %3u BPM: %u clicks, %u bad spacings\n",
+		    bpm[x], other, clicks, err);
+
+		if (err != 0)
+			errors++;
+	}
+
+	if (errors != 0) {
+		printf("test_tempo: %u failures\n", errors);
+		return (1);
+	}
+	printf("test_tempo: OK\n");
+	return (0);
+}